@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# bbgeo, command line driver for libbbgeo (import, profile generation and
+# export in one run), built on the headless core so it runs without a
+# display
+#
+#-------------------------------------------------
+
+QT       = core sql concurrent
+
+TARGET = bbgeo
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../libbbgeo.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,350 @@
+/*
+    bbgeo, command line driver for libbbgeo
+
+    Imports a directory of GEF files, builds geotechnical profiles along the
+    polylines in a file and exports them in one run, for example
+
+      bbgeo --db levees.sqlite --import gef/ --profiles trajectories.txt
+            --export sti,dam,qgeo,kml --out result/ --threads 8 --timings -
+
+    The polyline file has one polyline per line, name;x,y;x,y;... in RD
+    coordinates (or latitude,longitude with --latlon), lines starting with
+    # are skipped.
+    With --timings every stage writes one JSON object per line (to the
+    given file or - for stdout) with its duration and throughput so runs can
+    be compared over time. Messages go to stderr.
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QFile>
+#include <QDir>
+#include <QTextStream>
+#include <QStringList>
+#include <QRegExp>
+
+#include "datastore.h"
+
+//exit codes
+#define BBGEO_OK 0
+#define BBGEO_USAGE 1
+#define BBGEO_FAILED 2
+
+struct sPolyline{
+    QString name;
+    QList<QPointF> points;
+};
+
+/*
+  Prints the error signal of DataStore to stderr
+  */
+class MessagePrinter : public QObject
+{
+    Q_OBJECT
+public slots:
+    void print(QString message)
+    {
+        QTextStream err(stderr);
+        err << message << "\n";
+    }
+};
+
+/*
+  Writes the timing of one stage as a line of JSON, see --timings
+  */
+class TimingLog
+{
+public:
+    TimingLog() : m_out(NULL) {}
+    ~TimingLog() { delete m_out; }
+
+    bool open(const QString &fileName)
+    {
+        bool ok;
+        if(fileName == "-"){
+            ok = m_file.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+        }else{
+            m_file.setFileName(fileName);
+            ok = m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+        }
+        if(ok)
+            m_out = new QTextStream(&m_file);
+        return ok;
+    }
+
+    void write(const QString &stage, qint64 msecs, int items, bool ok, const QJsonObject &extra = QJsonObject())
+    {
+        if(m_out == NULL)
+            return;
+        QJsonObject o = extra;
+        o.insert("stage", stage);
+        o.insert("msecs", double(msecs));
+        o.insert("items", items);
+        o.insert("itemsPerSecond", msecs > 0 ? 1000. * items / msecs : 0.);
+        o.insert("threads", QThreadPool::globalInstance()->maxThreadCount());
+        o.insert("ok", ok);
+        *m_out << QJsonDocument(o).toJson(QJsonDocument::Compact) << "\n";
+        m_out->flush();
+    }
+
+private:
+    QFile m_file;
+    QTextStream *m_out; //NULL if there is no timing output
+};
+
+/*
+  Reads the polyline file (see the top of this file), lat/lon points are
+  stored as x = longitude, y = latitude like DataStore expects them
+  */
+static bool readPolylines(const QString &fileName, bool latlon, QList<sPolyline> &polylines, QStringList &log)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        log.append(QString("Could not open the polyline file %1").arg(fileName));
+        return false;
+    }
+    QTextStream in(&file);
+    int lineNumber = 0;
+    while(!in.atEnd()){
+        QString line = in.readLine().trimmed();
+        lineNumber++;
+        if(line.isEmpty() || line.startsWith('#'))
+            continue;
+        QStringList args = line.split(';');
+        sPolyline polyline;
+        polyline.name = args.at(0).trimmed();
+        for(int i=1; i<args.count(); i++){
+            QStringList xy = args.at(i).split(',');
+            bool okX = false, okY = false;
+            double x = 0., y = 0.;
+            if(xy.count() == 2){
+                x = xy.at(0).trimmed().toDouble(&okX);
+                y = xy.at(1).trimmed().toDouble(&okY);
+            }
+            if(!okX || !okY){
+                log.append(QString("Invalid point '%1' on line %2 of %3").arg(args.at(i)).arg(lineNumber).arg(fileName));
+                return false;
+            }
+            polyline.points.append(latlon ? QPointF(y, x) : QPointF(x, y));
+        }
+        if(polyline.name.isEmpty())
+            polyline.name = QString("profile%1").arg(polylines.count() + 1);
+        if(polyline.points.count() < 2){
+            log.append(QString("The polyline on line %1 of %2 needs at least two points").arg(lineNumber).arg(fileName));
+            return false;
+        }
+        polylines.append(polyline);
+    }
+    return true;
+}
+
+//makes a profile name safe to use as a file name
+static QString fileNameFor(const QString &name)
+{
+    QString result = name;
+    result.replace(QRegExp("[^A-Za-z0-9_.-]"), "_");
+    return result;
+}
+
+static void printLog(const QStringList &log, bool verbose)
+{
+    QTextStream err(stderr);
+    for(int i=0; i<log.count(); i++){
+        if(verbose || log.at(i).startsWith("SKIPPED") || log.at(i).startsWith("Could not") || log.at(i).startsWith("Invalid"))
+            err << log.at(i) << "\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("bbgeo");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Imports cpts, builds geotechnical profiles and exports them with libbbgeo.");
+    parser.addHelpOption();
+    QCommandLineOption dbOption("db", "The database to work on (required).", "file");
+    QCommandLineOption importOption("import", "Import all GEF files in this directory.", "directory");
+    QCommandLineOption profilesOption("profiles", "Build a profile for every polyline in this file.", "file");
+    QCommandLineOption latlonOption("latlon", "The polyline points are latitude,longitude instead of RD x,y.");
+    QCommandLineOption methodOption("method", "Profile method, sampled (default) or voronoi.", "method", "sampled");
+    QCommandLineOption exportOption("export", "Comma separated export formats: sti, dam, qgeo, kml.", "formats");
+    QCommandLineOption outOption("out", "Directory for the exported files (default the current directory).", "directory", ".");
+    QCommandLineOption threadsOption("threads", "Number of worker threads (default all cores).", "n");
+    QCommandLineOption batchSizeOption("batch-size", "Number of GEF files that are read in parallel during the import.", "n");
+    QCommandLineOption timingsOption("timings", "Append the timing of every stage as JSON lines to this file, - for stdout.", "file");
+    QCommandLineOption verboseOption("verbose", "Print the full import log.");
+    parser.addOption(dbOption);
+    parser.addOption(importOption);
+    parser.addOption(profilesOption);
+    parser.addOption(latlonOption);
+    parser.addOption(methodOption);
+    parser.addOption(exportOption);
+    parser.addOption(outOption);
+    parser.addOption(threadsOption);
+    parser.addOption(batchSizeOption);
+    parser.addOption(timingsOption);
+    parser.addOption(verboseOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+    bool verbose = parser.isSet(verboseOption);
+
+    //check the arguments before anything is done
+    if(!parser.isSet(dbOption)){
+        err << "bbgeo: --db is required\n";
+        return BBGEO_USAGE;
+    }
+    QStringList formats;
+    if(parser.isSet(exportOption)){
+        formats = parser.value(exportOption).toLower().split(',', QString::SkipEmptyParts);
+        for(int i=0; i<formats.count(); i++){
+            formats[i] = formats[i].trimmed();
+            if(!(QStringList() << "sti" << "dam" << "qgeo" << "kml").contains(formats[i])){
+                err << "bbgeo: unknown export format " << formats[i] << "\n";
+                return BBGEO_USAGE;
+            }
+        }
+        if(!parser.isSet(profilesOption)){
+            err << "bbgeo: --export needs --profiles\n";
+            return BBGEO_USAGE;
+        }
+    }
+    DataStore::GeoProfileMethod method = DataStore::SampledProfile;
+    if(parser.value(methodOption) == "voronoi")
+        method = DataStore::VoronoiProfile;
+    else if(parser.value(methodOption) != "sampled"){
+        err << "bbgeo: unknown method " << parser.value(methodOption) << "\n";
+        return BBGEO_USAGE;
+    }
+    if(parser.isSet(threadsOption)){
+        int threads = parser.value(threadsOption).toInt();
+        if(threads < 1){
+            err << "bbgeo: --threads needs a positive number\n";
+            return BBGEO_USAGE;
+        }
+        QThreadPool::globalInstance()->setMaxThreadCount(threads);
+    }
+    int batchSize = 0;
+    if(parser.isSet(batchSizeOption)){
+        batchSize = parser.value(batchSizeOption).toInt();
+        if(batchSize < 1){
+            err << "bbgeo: --batch-size needs a positive number\n";
+            return BBGEO_USAGE;
+        }
+    }
+    TimingLog timings;
+    if(parser.isSet(timingsOption) && !timings.open(parser.value(timingsOption))){
+        err << "bbgeo: could not open " << parser.value(timingsOption) << "\n";
+        return BBGEO_USAGE;
+    }
+    QList<sPolyline> polylines;
+    if(parser.isSet(profilesOption)){
+        QStringList log;
+        if(!readPolylines(parser.value(profilesOption), parser.isSet(latlonOption), polylines, log)){
+            printLog(log, true);
+            return BBGEO_USAGE;
+        }
+    }
+    QDir outDir(parser.value(outOption));
+    if(!formats.isEmpty() && !outDir.mkpath(".")){
+        err << "bbgeo: could not create " << outDir.path() << "\n";
+        return BBGEO_USAGE;
+    }
+
+    DataStore store;
+    MessagePrinter printer;
+    QObject::connect(&store, SIGNAL(error(QString)), &printer, SLOT(print(QString)));
+    if(batchSize > 0)
+        store.setImportBatchSize(batchSize);
+    QElapsedTimer timer;
+
+    //load
+    timer.start();
+    bool ok = store.loadData(parser.value(dbOption));
+    timings.write("load", timer.elapsed(), store.getNumberOfCPTs() + store.getVSoils().count() + store.getNumberOfSoilTypes(), ok);
+    if(!ok)
+        return BBGEO_FAILED;
+
+    //import
+    if(parser.isSet(importOption)){
+        QStringList log;
+        int before = store.getNumberOfCPTs();
+        timer.start();
+        bool imported = store.importCPTS(parser.value(importOption), log);
+        QJsonObject extra;
+        extra.insert("batchSize", store.importBatchSize());
+        timings.write("import", timer.elapsed(), store.getNumberOfCPTs() - before, imported, extra);
+        printLog(log, verbose);
+    }
+
+    //profiles
+    int firstProfile = store.getProfiles().count();
+    QList<int> profileIndexes; //index in DataStore::getProfiles per polyline, -1 if it has no areas
+    if(!polylines.isEmpty()){
+        QList<QList<QPointF> > points;
+        for(int i=0; i<polylines.count(); i++)
+            points.append(polylines.at(i).points);
+        timer.start();
+        QFuture<GeoProfile2D*> future = parser.isSet(latlonOption) ?
+                    store.generateGeoProfiles2D(points, method) :
+                    store.generateGeoProfiles2DFromRD(points, method);
+        future.waitForFinished();
+        QList<GeoProfile2D*> profiles = future.results();
+        store.addGeoProfiles2D(profiles);
+        int built = 0;
+        for(int i=0; i<profiles.count(); i++){
+            if(profiles.at(i)->areas()->count() > 0){
+                profileIndexes.append(firstProfile + i);
+                built++;
+            }else{
+                profileIndexes.append(-1);
+                err << "No vsoils found along " << polylines.at(i).name << ", it is not exported\n";
+            }
+        }
+        QJsonObject extra;
+        extra.insert("method", parser.value(methodOption));
+        timings.write("profiles", timer.elapsed(), built, built == profiles.count(), extra);
+    }
+
+    //export, one stage per format
+    int failed = 0;
+    for(int f=0; f<formats.count(); f++){
+        const QString &format = formats.at(f);
+        int written = 0;
+        timer.start();
+        for(int i=0; i<profileIndexes.count(); i++){
+            int index = profileIndexes.at(i);
+            if(index < 0)
+                continue;
+            QString base = outDir.filePath(fileNameFor(polylines.at(i).name));
+            bool exported = false;
+            if(format == "sti"){
+                exported = store.exportGeoProfileToSTIfile(base + ".sti", index, 0);
+            }else if(format == "qgeo"){
+                exported = store.exportGeoProfileToQGeoFile(base + ".qgeo", index);
+            }else if(format == "kml"){
+                exported = store.exportGeoProfileToKMLfile(base + ".kml", index);
+            }else if(format == "dam"){
+                QString damPath = base + "_dam";
+                exported = QDir().mkpath(damPath) && store.exportGeoProfileToDAM(damPath, index);
+            }
+            if(exported){
+                written++;
+            }else{
+                err << "Could not export " << polylines.at(i).name << " to " << format << "\n";
+                failed++;
+            }
+        }
+        timings.write("export-" + format, timer.elapsed(), written, written == profileIndexes.count() - profileIndexes.count(-1));
+    }
+
+    err.flush();
+    return failed > 0 ? BBGEO_FAILED : BBGEO_OK;
+}
+
+#include "main.moc"
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# bench, benchmarks for the hot paths of libbbgeo with fixed-seed
+# workloads, writes its results as JSON
+#
+#-------------------------------------------------
+
+QT       = core sql concurrent
+
+TARGET = bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../libbbgeo.pri)
+
+SOURCES += main.cpp \
+    benchdata.cpp
+
+HEADERS += benchdata.h
@@ -0,0 +1,266 @@
+#include "benchdata.h"
+
+#include <QFile>
+#include <QDir>
+#include <QTextStream>
+#include <QVector>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+
+#include <cmath>
+
+#include "vsoil.h"
+#include "latlon.h"
+
+#define BENCH_NUM_SOILTYPES 8
+#define BENCH_CONNECTION "BenchData"
+
+/*
+  xorshift64*, good enough for test data and the same everywhere
+  */
+double BenchRandom::uniform()
+{
+    m_state ^= m_state >> 12;
+    m_state ^= m_state << 25;
+    m_state ^= m_state >> 27;
+    quint64 r = m_state * Q_UINT64_C(2685821657736338717);
+    return double(r >> 11) / double(Q_UINT64_C(1) << 53);
+}
+
+int BenchRandom::uniformInt(int min, int max)
+{
+    return qMin(max, min + int(uniform() * (max - min + 1)));
+}
+
+/*
+  qc [MPa] and rf [%] of a soiltype, used to make cpts that look like the
+  soil of the vsoils in the database
+  */
+static void soilValues(int soilType, double &qc, double &rf)
+{
+    static const double qcs[BENCH_NUM_SOILTYPES] = {0.3, 0.6, 1.0, 2.0, 5.0, 10.0, 15.0, 20.0};
+    static const double rfs[BENCH_NUM_SOILTYPES] = {8.0, 5.0, 3.5, 2.5, 1.5, 1.0, 0.7, 0.5};
+    qc = qcs[soilType % BENCH_NUM_SOILTYPES];
+    rf = rfs[soilType % BENCH_NUM_SOILTYPES];
+}
+
+QString BenchData::writeSyntheticGEF(const QString &dir, int rows, quint64 seed)
+{
+    QString fileName = QDir(dir).filePath(QString("synthetic_%1.gef").arg(seed));
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return QString();
+    BenchRandom random(seed);
+    QTextStream out(&file);
+    out << "#GEFID= 1, 1, 0\n";
+    out << "#COLUMN= 3\n";
+    out << "#COLUMNINFO= 1, m, sondeerlengte, 1\n";
+    out << "#COLUMNINFO= 2, MPa, conusweerstand, 2\n";
+    out << "#COLUMNINFO= 3, MPa, wrijvingsweerstand, 3\n";
+    out << "#XYID= 31000, 120000.00, 450000.00\n";
+    out << "#ZID= 31000, 0.50\n";
+    out << "#PROCEDURECODE= GEF-CPT-Report, 1, 0, 0, -\n";
+    out << "#EOH=\n";
+    for(int i=0; i<rows; i++){
+        double qc = random.uniform(0.2, 20.);
+        double fs = qc * random.uniform(0.005, 0.08);
+        out << QString("%1 %2 %3\n").arg(0.02 * (i + 1), 0, 'f', 2).arg(qc, 0, 'f', 3).arg(fs, 0, 'f', 4);
+    }
+    return fileName;
+}
+
+QString BenchData::writeRealShapedGEF(const QString &dir, double depth, quint64 seed)
+{
+    QString fileName = QDir(dir).filePath(QString("realshaped_%1.gef").arg(seed));
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return QString();
+    BenchRandom random(seed);
+    int rows = int(depth / 0.02);
+    QString eol = "\r\n";
+    QTextStream out(&file);
+    out << "#GEFID= 1, 1, 0" << eol;
+    out << "#FILEOWNER= Benchmark" << eol;
+    out << "#FILEDATE= 2014, 3, 12" << eol;
+    out << "#PROJECTID= CPT, 140312" << eol;
+    out << "#COMPANYID= Benchmark BV, -, 31" << eol;
+    out << "#COLUMN= 7" << eol;
+    out << "#COLUMNSEPARATOR= ;" << eol;
+    out << "#RECORDSEPARATOR= !" << eol;
+    out << "#COLUMNINFO= 1, m, sondeerlengte, 1" << eol;
+    out << "#COLUMNINFO= 2, MPa, conusweerstand, 2" << eol;
+    out << "#COLUMNINFO= 3, MPa, wrijvingsweerstand, 3" << eol;
+    out << "#COLUMNINFO= 4, %, wrijvingsgetal, 4" << eol;
+    out << "#COLUMNINFO= 5, MPa, waterspanning u2, 6" << eol;
+    out << "#COLUMNINFO= 6, graden, helling, 8" << eol;
+    out << "#COLUMNINFO= 7, m, gecorrigeerde diepte, 11" << eol;
+    out << "#COLUMNVOID= 1, -9999.000000" << eol;
+    out << "#COLUMNVOID= 2, -9999.000000" << eol;
+    out << "#COLUMNVOID= 3, -9999.000000" << eol;
+    out << "#COLUMNVOID= 4, -9999.000000" << eol;
+    out << "#COLUMNVOID= 5, -9999.000000" << eol;
+    out << "#COLUMNVOID= 6, -9999.000000" << eol;
+    out << "#COLUMNVOID= 7, -9999.000000" << eol;
+    out << "#LASTSCAN= " << rows << eol;
+    out << "#STARTDATE= 2014, 3, 11" << eol;
+    out << "#STARTTIME= 10, 12, 0.000000" << eol;
+    out << "#TESTID= BENCH-" << seed << eol;
+    out << "#XYID= 31000, " << QString::number(120000. + random.uniform(0., 1000.), 'f', 2) << ", "
+        << QString::number(450000. + random.uniform(0., 1000.), 'f', 2) << ", 0.01, 0.01" << eol;
+    out << "#ZID= 31000, " << QString::number(random.uniform(-1., 3.), 'f', 2) << ", 0.01" << eol;
+    out << "#PROCEDURECODE= GEF-CPT-Report, 1, 1, 0, -" << eol;
+    out << "#REPORTCODE= GEF-CPT-Report, 1, 1, 0, -" << eol;
+    out << "#MEASUREMENTTEXT= 4, conus met ronde kleefmantel, conustype" << eol;
+    out << "#MEASUREMENTTEXT= 6, NEN 5140, norm" << eol;
+    out << "#MEASUREMENTTEXT= 9, maaiveld, vast horizontaal vlak" << eol;
+    out << "#MEASUREMENTVAR= 1, 1000, mm2, nom. oppervlak conuspunt" << eol;
+    out << "#MEASUREMENTVAR= 2, 15000, mm2, oppervlakte kleefmantel" << eol;
+    out << "#MEASUREMENTVAR= 12, 0.000000, -, elektrische conus" << eol;
+    out << "#MEASUREMENTVAR= 13, 0.00, m, voorgeboorde/voorgegraven diepte" << eol;
+    out << "#EOH=" << eol;
+
+    //layers of 0.3 to 3 m, the values vary around those of the soiltype
+    int soilType = random.uniformInt(0, BENCH_NUM_SOILTYPES - 1);
+    double layerBottom = random.uniform(0.3, 3.);
+    double inclination = 0.;
+    for(int i=0; i<rows; i++){
+        double z = 0.02 * (i + 1);
+        if(z > layerBottom){
+            soilType = random.uniformInt(0, BENCH_NUM_SOILTYPES - 1);
+            layerBottom = z + random.uniform(0.3, 3.);
+        }
+        double qc, rf;
+        soilValues(soilType, qc, rf);
+        qc *= random.uniform(0.8, 1.2);
+        rf *= random.uniform(0.8, 1.2);
+        double fs = qc * rf / 100.;
+        double u2 = 0.01 * z * random.uniform(0.9, 1.1);
+        inclination += random.uniform(-0.01, 0.012);
+        if(random.uniform() < 0.002){ //a few rows without a measurement
+            out << QString("%1;-9999.000000;-9999.000000;-9999.000000;%2;%3;%4;!")
+                   .arg(z, 0, 'f', 2).arg(u2, 0, 'f', 4).arg(inclination, 0, 'f', 2).arg(z * 0.999, 0, 'f', 3) << eol;
+            continue;
+        }
+        out << QString("%1;%2;%3;%4;%5;%6;%7;!").arg(z, 0, 'f', 2).arg(qc, 0, 'f', 3).arg(fs, 0, 'f', 4)
+               .arg(rf, 0, 'f', 2).arg(u2, 0, 'f', 4).arg(inclination, 0, 'f', 2).arg(z * 0.999, 0, 'f', 3) << eol;
+    }
+    return fileName;
+}
+
+QPointF BenchData::databaseOrigin()
+{
+    return QPointF(100000., 430000.);
+}
+
+double BenchData::databaseSide(int numVSoils, double spacing)
+{
+    return std::sqrt(double(numVSoils)) * spacing;
+}
+
+static bool exec(QSqlQuery &qry, const QString &sql, QStringList &log)
+{
+    if(qry.exec(sql))
+        return true;
+    log.append(QString("Could not execute %1: %2").arg(sql).arg(qry.lastError().text()));
+    return false;
+}
+
+bool BenchData::writeDatabase(const QString &fileName, int numVSoils, double spacing, quint64 seed, QStringList &log)
+{
+    QFile::remove(fileName);
+    bool ok = true;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", BENCH_CONNECTION);
+        db.setDatabaseName(fileName);
+        if(!db.open()){
+            log.append(QString("Could not create %1").arg(fileName));
+            ok = false;
+        }
+        QSqlQuery qry(db);
+        //the columns in the order DBAdapter reads them
+        ok = ok && exec(qry, "CREATE TABLE soiltypes (id INTEGER PRIMARY KEY, name TEXT, description TEXT, source TEXT, "
+                             "ydry REAL, ysat REAL, c REAL, phi REAL, upsilon REAL, k REAL, MC_upsilon REAL, MC_E50 REAL, "
+                             "HS_E50 REAL, HS_Eoed REAL, HS_Eur REAL, HS_m REAL, SSC_lambda REAL, SSC_kappa REAL, SSC_mu REAL, "
+                             "Cp REAL, Cs REAL, Cap REAL, Cas REAL, cv REAL, color TEXT)", log);
+        ok = ok && exec(qry, "CREATE TABLE cpt (id INTEGER PRIMARY KEY, date TEXT, x REAL, y REAL, zmax REAL, zmin REAL, "
+                             "filename TEXT, vsoil_id INTEGER, latitude REAL, longitude REAL, name TEXT)", log);
+        ok = ok && exec(qry, "CREATE TABLE vsoil (id INTEGER PRIMARY KEY, x REAL, y REAL, latitude REAL, longitude REAL, "
+                             "source TEXT, data BLOB, name TEXT, levee_location INTEGER)", log);
+        ok = ok && db.transaction();
+
+        static const char *names[BENCH_NUM_SOILTYPES] = {"peat", "clay", "silty clay", "loam", "silty sand", "sand", "coarse sand", "gravel"};
+        static const char *colors[BENCH_NUM_SOILTYPES] = {"#7F5F3F", "#3F7F3F", "#5F9F5F", "#9F9F5F", "#DFDF7F", "#FFFF00", "#FFDF00", "#DFBF7F"};
+        qry.prepare("INSERT INTO soiltypes VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        for(int i=0; ok && i<BENCH_NUM_SOILTYPES; i++){
+            qry.bindValue(0, i + 1);
+            qry.bindValue(1, names[i]);
+            qry.bindValue(2, QString("benchmark %1").arg(names[i]));
+            qry.bindValue(3, "benchmark");
+            for(int p=4; p<24; p++)
+                qry.bindValue(p, 1. + i + 0.1 * p);
+            qry.bindValue(6, 10. - i); //c
+            qry.bindValue(7, 15. + 3. * i); //phi
+            qry.bindValue(24, colors[i]);
+            ok = qry.exec();
+        }
+
+        //positions on a jittered grid over the square
+        BenchRandom random(seed);
+        int perRow = qMax(1, int(std::ceil(std::sqrt(double(numVSoils)))));
+        QVector<QPointF> rd(numVSoils);
+        for(int i=0; i<numVSoils; i++){
+            rd[i] = databaseOrigin() + QPointF(((i % perRow) + random.uniform(0.1, 0.9)) * spacing,
+                                               ((i / perRow) + random.uniform(0.1, 0.9)) * spacing);
+        }
+        QVector<QPointF> latlon = LatLon::fromRD(rd);
+
+        qry.prepare("INSERT INTO vsoil VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        for(int i=0; ok && i<numVSoils; i++){
+            VSoilLayerList layers;
+            double z = random.uniform(-1., 3.);
+            int count = random.uniformInt(4, 16);
+            for(int j=0; j<count; j++){
+                VSoilLayer sl;
+                sl.zmax = z;
+                z -= random.uniform(0.2, 3.);
+                sl.zmin = z;
+                sl.soiltype_id = random.uniformInt(1, BENCH_NUM_SOILTYPES);
+                layers.append(sl);
+            }
+            qry.bindValue(0, i + 1);
+            qry.bindValue(1, rd.at(i).x());
+            qry.bindValue(2, rd.at(i).y());
+            qry.bindValue(3, latlon.at(i).y());
+            qry.bindValue(4, latlon.at(i).x());
+            qry.bindValue(5, (i % 3) ? "CPT conversion" : "borehole");
+            qry.bindValue(6, VSoil::layersToBlob(layers));
+            qry.bindValue(7, QString("vsoil %1").arg(i + 1));
+            qry.bindValue(8, 1 + i % 2);
+            ok = qry.exec();
+        }
+        if(!ok)
+            log.append(QString("Could not fill %1: %2").arg(fileName).arg(qry.lastError().text()));
+        ok = ok && db.commit();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(BENCH_CONNECTION);
+    return ok;
+}
+
+QList<QList<QPointF> > BenchData::polylines(int count, int numVSoils, double spacing, quint64 seed)
+{
+    BenchRandom random(seed);
+    double side = databaseSide(numVSoils, spacing);
+    QPointF origin = databaseOrigin();
+    QList<QList<QPointF> > result;
+    for(int i=0; i<count; i++){
+        //from the left to the right side with a bend somewhere in the middle
+        QList<QPointF> polyline;
+        polyline.append(origin + QPointF(0., random.uniform(0., side)));
+        polyline.append(origin + QPointF(random.uniform(0.3, 0.7) * side, random.uniform(0., side)));
+        polyline.append(origin + QPointF(side, random.uniform(0., side)));
+        result.append(polyline);
+    }
+    return result;
+}
@@ -0,0 +1,47 @@
+#ifndef BENCHDATA_H
+#define BENCHDATA_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QPointF>
+
+/*
+    Deterministic random numbers for the fixtures, the same seed gives the
+    same workload on every machine and every run
+ */
+class BenchRandom
+{
+public:
+    explicit BenchRandom(quint64 seed) : m_state(seed) {}
+
+    double uniform(); //[0, 1)
+    double uniform(double min, double max) { return min + (max - min) * uniform(); }
+    int uniformInt(int min, int max); //[min, max]
+
+private:
+    quint64 m_state;
+};
+
+/*
+    Fixture generators for the benchmarks, all of them write into dir
+ */
+namespace BenchData
+{
+    //minimal GEF file, space separated z, qc and fs
+    QString writeSyntheticGEF(const QString &dir, int rows, quint64 seed);
+    //GEF file shaped like the files of the field: long header, CRLF, ';'
+    //separated with a record separator, 7 columns, void values and a
+    //layered soil profile
+    QString writeRealShapedGEF(const QString &dir, double depth, quint64 seed);
+    //sqlite database with the soiltypes table and numVSoils vsoils spread
+    //over a square in RD coordinates at about spacing meters from each other
+    bool writeDatabase(const QString &fileName, int numVSoils, double spacing, quint64 seed, QStringList &log);
+    //the square that writeDatabase uses, x = min, y = min
+    QPointF databaseOrigin();
+    double databaseSide(int numVSoils, double spacing);
+    //polylines in RD coordinates that cross the square of writeDatabase
+    QList<QList<QPointF> > polylines(int count, int numVSoils, double spacing, quint64 seed);
+}
+
+#endif // BENCHDATA_H
@@ -0,0 +1,454 @@
+/*
+    bench, benchmarks for the hot paths of libbbgeo
+
+    Every benchmark runs a fixed workload (the fixtures come from BenchData
+    with fixed seeds) once to warm up and then a number of timed
+    repetitions. The results are written as one JSON document so runs can
+    be compared, for example with
+
+      bench --out results.json
+      bench --quick --filter latlon
+
+    --gef-dir adds the real GEF files of a directory to the readFromFile
+    benchmarks.
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDateTime>
+#include <QSysInfo>
+#include <QThreadPool>
+#include <QFile>
+#include <QDir>
+#include <QTextStream>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+#include <algorithm>
+
+#include "benchdata.h"
+#include "cpt.h"
+#include "vsoil.h"
+#include "dbadapter.h"
+#include "datastore.h"
+#include "latlon.h"
+
+#define BENCH_SPACING 50. //[m] between the vsoils of the test databases
+
+static bool verboseMessages = false;
+
+static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(context)
+    //the library logs every file it reads, that would end up in the timings
+    if(type == QtDebugMsg && !verboseMessages)
+        return;
+    QTextStream(stderr) << message << "\n";
+}
+
+/*
+  A benchmark body, run() does the work once and returns the number of
+  items it handled (rows, vsoils, points etc.). cleanup() is called after
+  every run outside of the timing, to undo what the run added.
+  */
+struct sBenchmark{
+    virtual ~sBenchmark() {}
+    virtual qint64 run() = 0;
+    virtual void cleanup() {}
+};
+
+/*
+  Runs the benchmarks and collects their results
+  */
+class BenchRunner
+{
+public:
+    BenchRunner(const QString &filter, int repetitions) : m_filter(filter), m_repetitions(repetitions) {}
+
+    bool wanted(const QString &name) const { return m_filter.isEmpty() || name.contains(m_filter); }
+
+    void run(const QString &name, int size, sBenchmark &benchmark)
+    {
+        if(!wanted(name))
+            return;
+        QTextStream(stderr) << name << " (" << size << ")...\n";
+        benchmark.run(); //warm up, builds the caches the benchmark does not measure
+        benchmark.cleanup();
+        QVector<double> msecs;
+        qint64 items = 0;
+        QElapsedTimer timer;
+        for(int i=0; i<m_repetitions; i++){
+            timer.start();
+            items = benchmark.run();
+            msecs.append(timer.nsecsElapsed() / 1e6);
+            benchmark.cleanup();
+        }
+        std::sort(msecs.begin(), msecs.end());
+        double sum = 0.;
+        for(int i=0; i<msecs.count(); i++)
+            sum += msecs.at(i);
+        double median = msecs.at(msecs.count() / 2);
+
+        QJsonObject result;
+        result.insert("name", name);
+        result.insert("size", size);
+        result.insert("repetitions", m_repetitions);
+        result.insert("items", double(items));
+        result.insert("msecsMin", msecs.first());
+        result.insert("msecsMedian", median);
+        result.insert("msecsMean", sum / msecs.count());
+        result.insert("msecsMax", msecs.last());
+        result.insert("itemsPerSecond", median > 0. ? 1000. * items / median : 0.);
+        m_results.append(result);
+    }
+
+    QJsonArray results() const { return m_results; }
+
+private:
+    QString m_filter;
+    int m_repetitions;
+    QJsonArray m_results;
+};
+
+/*
+  The benchmarks, one struct per path
+  */
+struct sReadCPTBenchmark : sBenchmark{
+    QStringList files;
+    qint64 run()
+    {
+        qint64 rows = 0;
+        for(int i=0; i<files.count(); i++){
+            CPT cpt;
+            QStringList log;
+            if(cpt.readFromFile(files.at(i), log))
+                rows += cpt.series().count();
+        }
+        return rows;
+    }
+};
+
+struct sGenerateVSoilBenchmark : sBenchmark{
+    CPT *cpt;
+    bool segmented;
+    qint64 run()
+    {
+        qint64 layers = 0;
+        for(int i=0; i<50; i++){
+            VSoil vs;
+            if(segmented)
+                cpt->generateVSoilBySegments(vs, CPT::defaultSegmentation());
+            else
+                cpt->generateVSoil(vs, 0.1);
+            layers += vs.getSoilLayers()->count();
+        }
+        return layers;
+    }
+};
+
+struct sGetAllVSoilsBenchmark : sBenchmark{
+    DBAdapter *db;
+    qint64 run()
+    {
+        QList<VSoil*> vsoils;
+        db->getAllVSoils(vsoils);
+        qint64 count = vsoils.count();
+        qDeleteAll(vsoils);
+        return count;
+    }
+};
+
+struct sBlobParsingBenchmark : sBenchmark{
+    QList<QByteArray> blobs;
+    qint64 run()
+    {
+        qint64 layers = 0;
+        for(int i=0; i<blobs.count(); i++){
+            VSoilLayerList list;
+            VSoil::blobToLayers(blobs.at(i), list);
+            layers += list.count();
+        }
+        return layers;
+    }
+};
+
+struct sClosestVSoilBenchmark : sBenchmark{
+    DataStore *store;
+    QList<QPointF> points;
+    qint64 run()
+    {
+        qint64 found = 0;
+        for(int i=0; i<points.count(); i++)
+            if(store->getVSoilIdClosestTo(points.at(i)) > -1)
+                found++;
+        return found;
+    }
+};
+
+struct sGeoProfileBenchmark : sBenchmark{
+    DataStore *store;
+    QList<QList<QPointF> > latlonPolylines;
+    DataStore::GeoProfileMethod method;
+    qint64 run()
+    {
+        for(int i=0; i<latlonPolylines.count(); i++)
+            store->generateGeoProfile2D(latlonPolylines[i], method);
+        return latlonPolylines.count();
+    }
+    void cleanup() { store->clearGeoProfiles2D(); } //else every run adds to the profiles of the store
+};
+
+struct sLatLonBatchBenchmark : sBenchmark{
+    QVector<QPointF> input;
+    QVector<QPointF> output;
+    bool toRD;
+    qint64 run()
+    {
+        if(toRD)
+            LatLon::toRD(input.constData(), output.data(), input.count());
+        else
+            LatLon::fromRD(input.constData(), output.data(), input.count());
+        return input.count();
+    }
+};
+
+struct sLatLonScalarBenchmark : sBenchmark{
+    QVector<QPointF> latlon;
+    double checksum;
+    qint64 run()
+    {
+        checksum = 0.;
+        for(int i=0; i<latlon.count(); i++){
+            LatLon ll(latlon.at(i).y(), latlon.at(i).x());
+            checksum += ll.asRDCoords().x();
+        }
+        return latlon.count();
+    }
+};
+
+struct sExportBenchmark : sBenchmark{
+    enum Format { STI, DAM, QGeo, KML, CSV };
+    DataStore *store;
+    int profileIndex;
+    Format format;
+    QString path;
+    qint64 run()
+    {
+        switch(format){
+        case STI: store->exportGeoProfileToSTIfile(path + ".sti", profileIndex, 0); break;
+        case DAM: store->exportGeoProfileToDAM(path, profileIndex); break;
+        case QGeo: store->exportGeoProfileToQGeoFile(path + ".qgeo", profileIndex); break;
+        case KML: store->exportGeoProfileToKMLfile(path + ".kml", profileIndex); break;
+        case CSV: store->exportGeoProfileSoiltypesToCSVFile(path + ".csv", profileIndex); break;
+        }
+        return store->getProfiles().at(profileIndex)->areas()->count();
+    }
+};
+
+static QList<QPointF> toLatLon(const QList<QPointF> &rd)
+{
+    return LatLon::fromRD(rd.toVector()).toList();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the hot paths of libbbgeo and writes the results as JSON.");
+    parser.addHelpOption();
+    QCommandLineOption outOption("out", "Write the results to this file instead of stdout.", "file");
+    QCommandLineOption filterOption("filter", "Only run the benchmarks with this text in their name.", "text");
+    QCommandLineOption quickOption("quick", "Smaller datasets and fewer repetitions.");
+    QCommandLineOption repetitionsOption("repetitions", "Timed repetitions per benchmark (default 10, 3 with --quick).", "n");
+    QCommandLineOption gefDirOption("gef-dir", "Also read the GEF files in this directory.", "directory");
+    QCommandLineOption verboseOption("verbose", "Show the debug messages of the library.");
+    parser.addOption(outOption);
+    parser.addOption(filterOption);
+    parser.addOption(quickOption);
+    parser.addOption(repetitionsOption);
+    parser.addOption(gefDirOption);
+    parser.addOption(verboseOption);
+    parser.process(app);
+
+    verboseMessages = parser.isSet(verboseOption);
+    qInstallMessageHandler(messageHandler);
+    bool quick = parser.isSet(quickOption);
+    int repetitions = quick ? 3 : 10;
+    if(parser.isSet(repetitionsOption))
+        repetitions = qMax(1, parser.value(repetitionsOption).toInt());
+    BenchRunner runner(parser.value(filterOption), repetitions);
+
+    QTemporaryDir tempDir;
+    if(!tempDir.isValid()){
+        QTextStream(stderr) << "bench: could not create a temporary directory\n";
+        return 1;
+    }
+    QDir dir(tempDir.path());
+
+    //CPT::readFromFile
+    {
+        sReadCPTBenchmark synthetic;
+        for(int i=0; i<10; i++)
+            synthetic.files.append(BenchData::writeSyntheticGEF(dir.path(), 1000, 100 + i));
+        runner.run("cpt.readFromFile/synthetic", 1000, synthetic);
+
+        sReadCPTBenchmark realShaped;
+        for(int i=0; i<10; i++)
+            realShaped.files.append(BenchData::writeRealShapedGEF(dir.path(), 30., 200 + i));
+        runner.run("cpt.readFromFile/realshaped", 1500, realShaped);
+
+        if(parser.isSet(gefDirOption)){
+            sReadCPTBenchmark real;
+            QFileInfoList infos = QDir(parser.value(gefDirOption)).entryInfoList(QStringList("*.gef"), QDir::Files);
+            for(int i=0; i<infos.count(); i++)
+                real.files.append(infos.at(i).filePath());
+            runner.run("cpt.readFromFile/real", real.files.count(), real);
+        }
+    }
+
+    //CPT::generateVSoil
+    {
+        CPT cpt;
+        QStringList log;
+        cpt.readFromFile(BenchData::writeRealShapedGEF(dir.path(), 30., 300), log);
+        sGenerateVSoilBenchmark intervals;
+        intervals.cpt = &cpt;
+        intervals.segmented = false;
+        runner.run("cpt.generateVSoil", cpt.series().count(), intervals);
+        sGenerateVSoilBenchmark segments;
+        segments.cpt = &cpt;
+        segments.segmented = true;
+        runner.run("cpt.generateVSoilBySegments", cpt.series().count(), segments);
+    }
+
+    //LatLon
+    {
+        int count = quick ? 100000 : 1000000;
+        BenchRandom random(400);
+        sLatLonBatchBenchmark toRD, fromRD;
+        toRD.toRD = true;
+        fromRD.toRD = false;
+        for(int i=0; i<count; i++){
+            toRD.input.append(QPointF(random.uniform(3.4, 7.2), random.uniform(50.8, 53.5))); //(lon, lat)
+            fromRD.input.append(QPointF(random.uniform(10000., 280000.), random.uniform(305000., 615000.)));
+        }
+        toRD.output.resize(count);
+        fromRD.output.resize(count);
+        runner.run("latlon.toRD/batch", count, toRD);
+        runner.run("latlon.fromRD/batch", count, fromRD);
+        sLatLonScalarBenchmark scalar;
+        scalar.latlon = toRD.input;
+        runner.run("latlon.asRDCoords/scalar", count, scalar);
+    }
+
+    //the paths that need a database, per dataset size
+    QList<int> sizes;
+    sizes << 1000 << 10000;
+    if(!quick)
+        sizes << 100000;
+    for(int s=0; s<sizes.count(); s++){
+        int size = sizes.at(s);
+        QString dbFileName = dir.filePath(QString("bench_%1.sqlite").arg(size));
+        QStringList log;
+        if(!BenchData::writeDatabase(dbFileName, size, BENCH_SPACING, 500 + s, log)){
+            QTextStream(stderr) << log.join("\n") << "\n";
+            return 1;
+        }
+
+        //DBAdapter::getAllVSoils and the blob parsing on its own
+        if(runner.wanted("dbadapter") || runner.wanted("vsoil.blobToLayers")){
+            DBAdapter *db = new DBAdapter(NULL, "bench");
+            db->openDB(dbFileName);
+            sGetAllVSoilsBenchmark getAll;
+            getAll.db = db;
+            runner.run("dbadapter.getAllVSoils", size, getAll);
+            db->closeDB();
+            delete db;
+
+            sBlobParsingBenchmark blobs;
+            {
+                QSqlDatabase sql = QSqlDatabase::addDatabase("QSQLITE", "benchblobs");
+                sql.setDatabaseName(dbFileName);
+                sql.open();
+                QSqlQuery qry(sql);
+                qry.exec("SELECT data FROM vsoil");
+                while(qry.next())
+                    blobs.blobs.append(qry.value(0).toByteArray());
+                sql.close();
+            }
+            QSqlDatabase::removeDatabase("benchblobs");
+            runner.run("vsoil.blobToLayers", size, blobs);
+        }
+
+        //DataStore queries and profiles
+        DataStore *store = new DataStore();
+        store->loadDataNonUI(dbFileName);
+
+        BenchRandom random(600 + s);
+        QPointF origin = BenchData::databaseOrigin();
+        double side = BenchData::databaseSide(size, BENCH_SPACING);
+        sClosestVSoilBenchmark closest;
+        closest.store = store;
+        for(int i=0; i<10000; i++)
+            closest.points.append(origin + QPointF(random.uniform(0., side), random.uniform(0., side)));
+        runner.run("datastore.getVSoilIdClosestTo", size, closest);
+
+        QList<QList<QPointF> > rdPolylines = BenchData::polylines(10, size, BENCH_SPACING, 700 + s);
+        sGeoProfileBenchmark sampled;
+        sampled.store = store;
+        sampled.method = DataStore::SampledProfile;
+        for(int i=0; i<rdPolylines.count(); i++)
+            sampled.latlonPolylines.append(toLatLon(rdPolylines.at(i)));
+        runner.run("datastore.generateGeoProfile2D/sampled", size, sampled);
+        sGeoProfileBenchmark voronoi = sampled;
+        voronoi.method = DataStore::VoronoiProfile;
+        runner.run("datastore.generateGeoProfile2D/voronoi", size, voronoi);
+
+        //the exporters on one profile of the middle dataset
+        if(size == 10000 && runner.wanted("export")){
+            QList<QPointF> line = toLatLon(BenchData::polylines(1, size, BENCH_SPACING, 800).first());
+            store->generateGeoProfile2D(line, DataStore::SampledProfile);
+            sExportBenchmark exporter;
+            exporter.store = store;
+            exporter.profileIndex = store->getProfiles().count() - 1;
+            int areas = store->getProfiles().last()->areas()->count();
+            const char *names[] = {"export.sti", "export.dam", "export.qgeo", "export.kml", "export.csv"};
+            for(int f=sExportBenchmark::STI; f<=sExportBenchmark::CSV; f++){
+                exporter.format = sExportBenchmark::Format(f);
+                exporter.path = dir.filePath(QString("export_%1").arg(f));
+                dir.mkpath(exporter.path); //DAM writes into a directory
+                runner.run(names[f], areas, exporter);
+            }
+        }
+        delete store;
+    }
+
+    QJsonObject document;
+    document.insert("library", "libbbgeo");
+    document.insert("qtVersion", QString(qVersion()));
+    document.insert("cpu", QSysInfo::currentCpuArchitecture());
+    document.insert("os", QSysInfo::prettyProductName());
+    document.insert("threads", QThreadPool::globalInstance()->maxThreadCount());
+    document.insert("date", QDateTime::currentDateTime().toString(Qt::ISODate));
+    document.insert("quick", quick);
+    document.insert("results", runner.results());
+    QByteArray json = QJsonDocument(document).toJson();
+
+    if(parser.isSet(outOption)){
+        QFile file(parser.value(outOption));
+        if(!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()){
+            QTextStream(stderr) << "bench: could not write " << parser.value(outOption) << "\n";
+            return 1;
+        }
+    }else{
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
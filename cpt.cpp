@@ -1,16 +1,25 @@
 #include "cpt.h"
 #include <QStringList>
-#include <QFile>
-#include <QTextStream>
 
 #include <QDebug>
-#include <QFileInfo>
 
-#include "latlon.h"
-#include <cmath>
+#include <limits>
+
+#include "gefparser.h"
+#include "varint.h"
 
 #define COLVOID 9999
 
+//layout of the binary blob, see dataAsQByteArray
+#define CPTBLOB_MAGIC0 char(0xBB)
+#define CPTBLOB_MAGIC1 'C'
+#define CPTBLOB_VERSION 1
+#define CPTBLOB_HEADERSIZE 3
+#define CPTBLOB_COLUMNS 4
+
+//decimals that are kept per column; z [mm], qc [kPa], fs [0.1 kPa], wg [0.001 %]
+static const int cptBlobDecimals[CPTBLOB_COLUMNS] = {3, 3, 4, 3};
+
 CPT::CPT(QObject *parent) :
     QObject(parent)
 {
@@ -22,311 +31,471 @@ CPT::CPT(QObject *parent) :
     m_metaData.zmin = 0.;
     m_metaData.fileName = "";
     m_metaData.date = QDateTime(QDate(1900,1,1));
-    m_z = new QList<double>;
-    m_qc = new QList<double>;
-    m_pw = new QList<double>;
-    m_wg = new QList<double>;
+    m_metaData.vsoilId = -1;
+    m_parseThroughput = 0.;
 }
 
 CPT::~CPT()
 {
-    m_z->clear();
-    m_qc->clear();
-    m_pw->clear();
-    m_wg->clear();
 }
 
-/*
-    Return a list of strings containing the values like;
-    -1.23;1.234;0.013;0.562
-
-    where these values stand for
+static double decimalsToScale(int decimals)
+{
+    double scale = 1.;
+    for(int i=0; i<decimals; i++)
+        scale *= 10.;
+    return scale;
+}
 
-    z [m tov ref];qc [MPa];fs [MPa];wg [%]
+/*
+    Returns the series in a compressed columnar layout
+    magic (0xBB 'C'), version, qCompress(payload)
+    with the payload
+    varint number of points, per column the number of decimals (1 byte),
+    then column after column (z, qc, fs, wg) the differences between the
+    values scaled to integers as zigzag varints.
+    z is kept in mm, qc in kPa, fs in 0.1 kPa and wg in 0.001 %.
 */
 QByteArray CPT::dataAsQByteArray()
 {
-    QByteArray result;
-    for(int i=0; i<m_z->count();i++){
-        result.append(QString("%1;%2;%3;%4\n")\
-                      .arg(m_z->at(i), 2, 'f')\
-                      .arg(m_qc->at(i), 3, 'f')\
-                      .arg(m_pw->at(i), 3, 'f')\
-                      .arg(m_wg->at(i), 3, 'f'));
+    int n = m_series.count();
+
+    //a 64 bit varint takes at most 10 bytes
+    QByteArray payload(10 + CPTBLOB_COLUMNS + CPTBLOB_COLUMNS * n * 10, Qt::Uninitialized);
+    char *p = payload.data();
+    p = putVarint(p, quint64(n));
+    for(int c=0; c<CPTBLOB_COLUMNS; c++)
+        *p++ = char(cptBlobDecimals[c]);
+    for(int c=0; c<CPTBLOB_COLUMNS; c++){
+        double scale = decimalsToScale(cptBlobDecimals[c]);
+        CPTColumn column = m_series.column(CPTSeries::Column(c));
+        qint64 previous = 0;
+        for(int i=0; i<n; i++){
+            qint64 value = qRound64(column.at(i) * scale);
+            p = putVarint(p, zigzag(value - previous));
+            previous = value;
+        }
     }
+    payload.resize(p - payload.constData());
+
+    QByteArray result;
+    result.reserve(CPTBLOB_HEADERSIZE + payload.size() / 2);
+    result.append(CPTBLOB_MAGIC0);
+    result.append(CPTBLOB_MAGIC1);
+    result.append(char(CPTBLOB_VERSION));
+    result.append(qCompress(payload));
     return result;
 }
 
 /*
-    Returns the values at the given depth. Returns NULL if z is out of range
+    Reads the series from a blob written by dataAsQByteArray, the current
+    series are replaced. Returns false if the blob is not valid.
 */
-double CPT::getQcAt(double z){
-    for(int i=0; i<m_qc->count(); i++)
-        if (m_z->at(i) < z)
-            return m_qc->at(i);
-    //TODO: raise exception
-    return 0.;
+bool CPT::blobToData(const QByteArray &data)
+{
+    m_series.clear();
+    if((data.size() < CPTBLOB_HEADERSIZE) || (data.at(0) != CPTBLOB_MAGIC0) || (data.at(1) != CPTBLOB_MAGIC1) ||
+       (uchar(data.at(2)) != CPTBLOB_VERSION)){
+        qDebug() << "Error in CPT::blobToData; unknown data layout for cpt id =" << m_metaData.id;
+        return false;
+    }
+    QByteArray payload = qUncompress(reinterpret_cast<const uchar*>(data.constData() + CPTBLOB_HEADERSIZE),
+                                     data.size() - CPTBLOB_HEADERSIZE);
+    const char *p = payload.constData();
+    const char *end = p + payload.size();
+
+    quint64 n;
+    p = getVarint(p, end, n);
+    if((p == NULL) || (end - p < CPTBLOB_COLUMNS) || (n > quint64(payload.size()))){
+        qDebug() << "Error in CPT::blobToData; invalid data for cpt id =" << m_metaData.id;
+        return false;
+    }
+    double scales[CPTBLOB_COLUMNS];
+    for(int c=0; c<CPTBLOB_COLUMNS; c++){
+        int decimals = uchar(*p++);
+        if(decimals > 9){
+            qDebug() << "Error in CPT::blobToData; invalid data for cpt id =" << m_metaData.id;
+            return false;
+        }
+        scales[c] = decimalsToScale(decimals);
+    }
+
+    m_series.resize(int(n));
+    for(int c=0; c<CPTBLOB_COLUMNS; c++){
+        qint64 value = 0;
+        for(quint64 i=0; i<n; i++){
+            quint64 delta;
+            p = getVarint(p, end, delta);
+            if(p == NULL){
+                qDebug() << "Error in CPT::blobToData; truncated data for cpt id =" << m_metaData.id;
+                m_series.clear();
+                return false;
+            }
+            value += unzigzag(delta);
+            m_series.setValue(CPTSeries::Column(c), int(i), double(value) / scales[c]);
+        }
+    }
+    return true;
 }
 
-double CPT::getWgAt(double z)
+/*
+    Returns the index of the first sample below z (zs[i] < z) or n if there
+    is none. The depths go down from the top of the cpt.
+*/
+template <typename T>
+static int firstBelow(const T *zs, int n, double z)
 {
-    for(int i=0; i<m_wg->count(); i++)
-        if (m_z->at(i) < z)
-            return m_wg->at(i);
-    //TODO: raise exception
-    return 0.;
+    int lo = 0, hi = n;
+    while(lo < hi){
+        int mid = (lo + hi) / 2;
+        if(zs[mid] < z)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
 }
 
-double CPT::getPwAt(double z)
+static int firstBelow(const CPTColumn &zs, double z)
 {
-    for(int i=0; i<m_pw->count(); i++)
-        if (m_z->at(i) < z)
-            return m_pw->at(i);
-    //TODO: raise exception
-    return 0.;
+    if(zs.isFloat())
+        return firstBelow(zs.floatData(), zs.count(), z);
+    return firstBelow(zs.doubleData(), zs.count(), z);
 }
 
 /*
-    Reads a CPT from a GEF file.
+    Returns the value of the column at the given depth, ok is set to false
+    if z is outside of the cpt. For backwards compatibility the value above
+    the cpt is the first value and below the cpt it is 0.
 */
-bool CPT::readFromFile(const QString filename, QStringList &log)
+double CPT::valueAt(CPTSeries::Column column, double z, Interpolation method, bool *ok) const
 {
-    qDebug() << QString("CPT::readFromFile(%1)").arg(filename);
-    bool readHeader = true;
-    bool hasXY = false;
-    bool ok; //used to check all string -> float / int conversions
-    int colid[4] = {-1, -1, -1, -1}; //dz, qc, pw, wg
-    int colvoid[4] = {9999, 9999, 9999, 9999}; ////dz, qc, pw, wg
-
-    QString typegef = "notset";
-    QChar columnseperator = ' ';
-
-    QFile file(filename);    
-    //try to open the file
-    if(!file.open(QIODevice::ReadOnly)) {        
-        log.append(QString("ERROR in file %1: %2").arg(filename).arg(file.errorString()));
-        return false;
+    CPTColumn zs = m_series.z();
+    CPTColumn values = m_series.column(column);
+    int n = zs.count();
+    int i = firstBelow(zs, z);
+    if(ok) *ok = (i > 0) && (i < n);
+
+    if(i == n){
+        if(method == Linear && n > 0 && zs.last() == z){ //exactly on the last sample
+            if(ok) *ok = true;
+            return values.last();
+        }
+        //TODO: raise exception
+        return 0.;
     }
+    if(method == Step || i == 0)
+        return values.at(i);
+    double z1 = zs.at(i-1);
+    double z2 = zs.at(i);
+    double t = (z1 - z) / (z1 - z2);
+    return values.at(i-1) + t * (values.at(i) - values.at(i-1));
+}
 
-    //extract the filename
-    QFileInfo fi(filename);
-    m_metaData.name = fi.fileName().split('.')[0];
-    m_metaData.fileName = file.fileName();
-
-    //and read the file
-    QTextStream in(&file);
-
-    while(!in.atEnd()) {
-        QString line = in.readLine();
-        if(readHeader){
-            QString keyword = line.split('=')[0].trimmed();
-            QStringList args = line.split('=')[1].split(',');
-            if (line.contains("#EOH")){
-                //als er geen qc en pw is zijn we niet geinteresseerd in de sondering
-                if ((colid[1]==-1) || (colid[2]==-1)){
-                    log.append(QString("ERROR in file %1: Found gef file without qc or fs.").arg(filename));
-                    return false;
-                }
-                if (colid[0]==-1){
-                    log.append(QString("ERROR in file %1: Found gef file without columninfo for z.").arg(filename));
-                    return false;
-                }
-                //stop met de header en start het lezen van de data
-                readHeader = false;
-            }else if (keyword =="#STARTDATE"){
-                int year = args.at(0).trimmed().toInt();
-                int month = args.at(1).trimmed().toInt();
-                int day = args.at(2).trimmed().toInt();
-                m_metaData.date = QDateTime(QDate(year, month, day));
-
-            }else if (keyword =="#FILEDATE"){ //some people skip the startdate which is stupid but the filedate will do in this case
-                if (m_metaData.date.date().year() == 1900){
-                    int year = args.at(0).trimmed().toInt();
-                    int month = args.at(1).trimmed().toInt();
-                    int day = args.at(2).trimmed().toInt();
-                    m_metaData.date = QDateTime(QDate(year, month, day));
-                }
-            }else if (keyword =="#COLUMNSEPARATOR"){
-                QString cs = args.at(0).trimmed();
-                if (cs.length()>0)
-                    columnseperator = cs[0]; //TODO: check, gaat dat goed.. soms is [0] de lengte van de string
-            }else if ((keyword =="#REPORTCODE")||(keyword=="#PROCEDURECODE")){
-                if (line.toUpper().contains("CPT-REPORT")){
-                    typegef = "sondering";
-                }
-            }else if (keyword =="#ZID"){
-                m_metaData.zmax = args.at(1).trimmed().toDouble(&ok);
-                if (!ok){
-                    log.append(QString("ERROR in file %1: Invalid X coord: %2").arg(filename).arg(args.at(1)));
-                    return false;
-                }
-            }else if (keyword =="#XYID"){                
-                m_metaData.x = args.at(1).trimmed().toDouble(&ok);
-                if (!ok){
-                    log.append(QString("ERROR in file %1: Invalid X coord: %2").arg(filename).arg(args.at(1)));
-                    return false;
-                }
-                m_metaData.y = args.at(2).trimmed().toDouble(&ok);
-                if (!ok) {
-                    log.append(QString("ERROR in file %1: Invalid Y coord: %2").arg(filename).arg(args.at(1)));
-                    return false;
-                }
-                //calculate the latitude and longitude from the rdcoords
-                LatLon ll;
-                ll.fromRDCoords(m_metaData.x, m_metaData.y);
-                m_metaData.latitude = ll.getLatitude();
-                m_metaData.longitude = ll.getLongitude();
-                hasXY = true;
-            }else if (keyword == "#COLUMNVOID"){
-                /*
-                    ga er van uit dat altijd eerst columninfo wordt ingevuld en daarna columnvoid
-                    zo niet dan is er programmeerwerk nodig!
-                */
-                if (colid[1]==-1){
-                    log.append(QString("ERROR in file %1: Found gef file with columnvoid defined before columninfo").arg(filename));
-                    return false;
-                }
-                int id = args.at(0).trimmed().toInt();
-                for(int i=0; i<4; i++){
-                    if(colid[i] == id){
-                        bool ok;
-                        colvoid[i] = static_cast<int>(args.at(1).trimmed().toDouble(&ok));
-                        //TODO: wat als het geen int is.. hypothetisch misschien maar toch
-                    }
-                }
-            }else if (keyword == "#COLUMNINFO"){
-                int id = args.at(3).trimmed().toInt();
-                if((id==1)||(id==11)){ //sondeerlengte of gecorrigeerde sondeerlengte
-                    colid[0] = args.at(0).trimmed().toInt() - 1;
-                }else if(id == 2){ //conusweerstand
-                    colid[1] = args.at(0).trimmed().toInt() - 1;
-                }else if(id == 3){ //wrijvingsweerstand
-                    colid[2] = args.at(0).trimmed().toInt() - 1;
-                }else if(id == 4){ //wrijvingsgetal
-                    colid[3] = args.at(0).trimmed().toInt() - 1;
-                }
-            }
-        }else{ //read data
-            if (typegef!="sondering"){
-                log.append(QString("ERROR in file %1: Not of type CPT").arg(filename));
-                return false;
-            }
-            else if(!hasXY){
-                log.append(QString("ERROR in file %1: No coordinates found (#XYID)").arg(filename));
-                return false;
-            }
-            else{
-                QStringList args; //filtered arguments
-                QStringList _args = line.split(columnseperator); //non filtered arguments
-                for (int i=0; i<_args.count(); i++){
-                    if (_args.at(i).length()>0){ //if the argument is larger than 1 character add it to the filtered arguments
-                        args.append(_args.at(i).trimmed());
-                    }
-                }
-
-                double qc = args.at(colid[1]).toDouble(&ok);
-                if (!ok){
-                    log.append(QString("ERROR in file %1: Invalid qc value: %2").arg(filename).arg(args.at(colid[1])));
-                    return false;
-                }
-                double pw = args.at(colid[2]).toDouble(&ok);
-                if (!ok){
-                    log.append(QString("ERROR in file %1: Invalid qc value: %2").arg(filename).arg(args.at(colid[1])));
-                    return false;
-                }
-                if((int(qc)!=colvoid[1]) && (int(pw)!=colvoid[2])){
-                    double dz = args.at(colid[0]).toDouble(&ok);
-                    if (!ok){
-                        log.append(QString("ERROR in file %1: Invalid dz value: %2").arg(filename).arg(args.at(colid[1])));
-                        return false;
-                    }
-
-                    if(qc <= 0.)
-                        qc = 0.01;
-                    double pw = args.at(colid[2]).toDouble();
-                    double wg;
-                    if(colid[3]==-1){
-                        wg = (pw / qc) * 100.;
-                    }else{
-                        wg = args.at(colid[3]).toDouble();
-                    }
-                    m_z->append(m_metaData.zmax - std::abs(dz));
-                    m_qc->append(qc);
-                    m_pw->append(pw);
-                    m_wg->append(wg);
-                }
+/*
+    Returns the values at the given depth, see valueAt
+*/
+double CPT::getQcAt(double z, Interpolation method, bool *ok) const
+{
+    return valueAt(CPTSeries::Qc, z, method, ok);
+}
+
+double CPT::getWgAt(double z, Interpolation method, bool *ok) const
+{
+    return valueAt(CPTSeries::Wg, z, method, ok);
+}
+
+double CPT::getPwAt(double z, Interpolation method, bool *ok) const
+{
+    return valueAt(CPTSeries::Pw, z, method, ok);
+}
+
+template <typename S, typename D>
+static void interpolateColumn(const S *src, const int *lo, const int *hi, const double *t, int m, D *dst)
+{
+    const D nan = std::numeric_limits<D>::quiet_NaN();
+    for(int k=0; k<m; k++){
+        if(lo[k] < 0){
+            dst[k] = nan;
+        }else{
+            double a = src[lo[k]];
+            double b = src[hi[k]];
+            dst[k] = D(a + t[k] * (b - a));
+        }
+    }
+}
+
+template <typename S>
+static void interpolateColumn(const S *src, const int *lo, const int *hi, const double *t, int m, CPTSeries &result, CPTSeries::Column c)
+{
+    if(result.isSinglePrecision())
+        interpolateColumn(src, lo, hi, t, m, result.floatColumn(c));
+    else
+        interpolateColumn(src, lo, hi, t, m, result.doubleColumn(c));
+}
+
+/*
+    Fills result with the qc, pw and wg values at all given depths in one
+    pass. The depths are looked up with a moving cursor if they go down (like
+    the cpt itself) else with a binary search per depth.
+    Depths outside of the cpt get NaN values and a false bit in inRange.
+    Returns the number of depths within the cpt.
+*/
+int CPT::resampleTo(const QVector<double> &depths, CPTSeries &result, QBitArray &inRange, Interpolation method) const
+{
+    int m = depths.count();
+    int n = m_series.count();
+    CPTColumn zs = m_series.z();
+
+    result = CPTSeries(m_series.isSinglePrecision());
+    result.resize(m);
+    inRange.fill(false, m);
+
+    //first find the samples (lo, hi) and weight t for every depth
+    QVector<int> lo(m), hi(m);
+    QVector<double> t(m);
+    int numInRange = 0;
+    int cursor = 0;
+    for(int k=0; k<m; k++){
+        double z = depths.at(k);
+        result.setValue(CPTSeries::Z, k, z);
+        int i;
+        if(k > 0 && z <= depths.at(k-1)){
+            //depths go down, move the cursor instead of searching
+            i = cursor;
+            while(i < n && !(zs.at(i) < z))
+                i++;
+        }else{
+            i = firstBelow(zs, z);
+        }
+        cursor = i;
+
+        lo[k] = -1;
+        t[k] = 0.;
+        if(i > 0 && i < n){
+            if(method == Step){
+                lo[k] = hi[k] = i;
+            }else{
+                double z1 = zs.at(i-1);
+                lo[k] = i - 1;
+                hi[k] = i;
+                t[k] = (z1 - z) / (z1 - zs.at(i));
             }
+        }else if(i == n && n > 0 && method == Linear && zs.last() == z){
+            lo[k] = hi[k] = n - 1;
+        }
+        if(lo[k] > -1){
+            inRange.setBit(k);
+            numInRange++;
         }
     }
-    m_metaData.zmin = m_z->at(m_z->count()-1);
-    file.close(); //TODO: in try except manier?
-    return true;
+
+    //then fill the channels one after the other
+    const CPTSeries::Column channels[3] = {CPTSeries::Qc, CPTSeries::Pw, CPTSeries::Wg};
+    for(int c=0; c<3; c++){
+        CPTColumn src = m_series.column(channels[c]);
+        if(src.isFloat())
+            interpolateColumn(src.floatData(), lo.constData(), hi.constData(), t.constData(), m, result, channels[c]);
+        else
+            interpolateColumn(src.doubleData(), lo.constData(), hi.constData(), t.constData(), m, result, channels[c]);
+    }
+    return numInRange;
 }
 
 /*
-    Returns a soiltype according to the table in CUR162 (electrical cone)
-    TODO: replace hard coded ids to database ids based on the soil name
- */
-int getSoiltypeByWgAndCUR162(double wg){
-    if (wg <= 0.6)
-        return 10000;
-    else if ((wg > 0.6) && (wg <= 0.8))
-        return 10001;
-    else if ((wg > 0.8) && (wg <= 1.1))
-        return 10002;
-    else if ((wg > 1.1) && (wg <= 1.4))
-        return 10003;
-    else if ((wg > 1.4) && (wg <= 1.8))
-        return 10004;
-    else if ((wg > 1.8) && (wg <= 2.2))
-        return 10005;
-    else if ((wg > 2.2) && (wg <= 2.5))
-        return 10006;
-    else if ((wg > 2.5) && (wg <= 5.0))
-        return 10007;
-    else if ((wg > 5.0) && (wg <= 8.1))
-        return 10008;
-    else
-        return 10009;
+    Reads a CPT from a GEF file, see GEFParser for the details.
+*/
+bool CPT::readFromFile(const QString filename, QStringList &log)
+{
+    qDebug() << QString("CPT::readFromFile(%1)").arg(filename);
+    GEFParser parser;
+    bool result = parser.parse(filename, m_metaData, m_series, log);
+    m_series.squeeze(); //drop the room left after growing the series
+    m_parseThroughput = parser.throughput();
+    return result;
 }
 
+static const CUR162Classifier defaultClassifier;
+
 /*
     Walks trough a cpt and makes soillayers every interval based on the
-    wg TODO: translate wg to something English
+    average qc and wg (friction ratio) of the interval. The intervals are
+    collected first and classified in one call, without a classifier the
+    CUR162 table is used.
  */
-void CPT::generateVSoil(VSoil &vsoil, double minInterval)
+void CPT::generateVSoil(VSoil &vsoil, double minInterval, const SoilClassifier *classifier)
 {
     vsoil.setLatitude(m_metaData.latitude);
     vsoil.setLongitude(m_metaData.longitude);
     vsoil.setX(m_metaData.x);
     vsoil.setY(m_metaData.y);
     vsoil.setSource("CPT conversion");
+    if(!classifier)
+        classifier = &defaultClassifier;
 
+    QVector<double> ztops, zbottoms, avgQcs, avgWgs;
     double ztop = zmax();
     int n = 0;
+    double sum_qc = 0.;
     double sum_wg = 0.;
-    for(int i=0; i<m_z->count(); i++){
-        double z = m_z->at(i);
-        double wg = m_wg->at(i);
-        sum_wg += wg;
+    CPTColumn zs = m_series.z();
+    CPTColumn qcs = m_series.qc();
+    CPTColumn wgs = m_series.wg();
+    for(int i=0; i<zs.count(); i++){
+        double z = zs.at(i);
+        sum_qc += qcs.at(i);
+        sum_wg += wgs.at(i);
         n += 1;
 
-        if(i==m_z->count()-1){
-            vsoil.addSoilLayer(ztop, z, getSoiltypeByWgAndCUR162(sum_wg / n));
-        }else if((ztop - z) > minInterval){
-            if(n==0){
-                //TODO ERROR
-            }else{
-                vsoil.addSoilLayer(ztop, z, getSoiltypeByWgAndCUR162(sum_wg / n));
-                ztop = z;
-                sum_wg = 0.;
-                n = 0;
-            }
-        }    
+        if((i==zs.count()-1) || ((ztop - z) > minInterval)){
+            ztops.append(ztop);
+            zbottoms.append(z);
+            avgQcs.append(sum_qc / n);
+            avgWgs.append(sum_wg / n);
+            ztop = z;
+            sum_qc = 0.;
+            sum_wg = 0.;
+            n = 0;
+        }
     }
+
+    QVector<int> soilTypeIds(ztops.count());
+    classifier->classifyToSoilTypeIds(avgQcs.constData(), avgWgs.constData(), ztops.count(), soilTypeIds.data());
+    for(int i=0; i<ztops.count(); i++)
+        vsoil.addSoilLayer(ztops.at(i), zbottoms.at(i), soilTypeIds.at(i));
     vsoil.optimize();
 }
 
+sSegmentation CPT::defaultSegmentation()
+{
+    sSegmentation settings;
+    settings.window = 10;
+    settings.minThickness = 0.2;
+    settings.qcTolerance = 0.3;
+    settings.wgTolerance = 0.5;
+    return settings;
+}
+
+/*
+    Splits the cpt into layers in one pass. The averages of qc and wg over
+    the last settings.window samples are compared with the averages of the
+    current layer above that window. If one of them changes more than its
+    tolerance the layer is split within the window (see the cusum below),
+    as long as the layer above the split is at least minThickness thick.
+    A last layer that is too thin is added to the layer above it.
+    The layers are classified in one call and neighbours with the same
+    soiltype are merged here, VSoil::optimize is not needed.
+ */
+void CPT::generateVSoilBySegments(VSoil &vsoil, const sSegmentation &settings, const SoilClassifier *classifier)
+{
+    vsoil.setLatitude(m_metaData.latitude);
+    vsoil.setLongitude(m_metaData.longitude);
+    vsoil.setX(m_metaData.x);
+    vsoil.setY(m_metaData.y);
+    vsoil.setSource("CPT conversion");
+    if(!classifier)
+        classifier = &defaultClassifier;
+
+    CPTColumn zs = m_series.z();
+    CPTColumn qcs = m_series.qc();
+    CPTColumn wgs = m_series.wg();
+    int n = zs.count();
+    if(n==0)
+        return;
+    int w = qMax(1, settings.window);
+
+    QVector<double> ztops, zbottoms, sumQcs, sumWgs;
+    QVector<int> counts;
+    double ztop = zmax();
+    double layer_qc = 0., layer_wg = 0.; //sums over the current layer including the window
+    double window_qc = 0., window_wg = 0.; //sums over the last w samples
+    int layer_n = 0;
+    for(int i=0; i<n; i++){
+        double qc = qcs.at(i);
+        double wg = wgs.at(i);
+        layer_qc += qc;
+        layer_wg += wg;
+        layer_n++;
+        window_qc += qc;
+        window_wg += wg;
+        if(i >= w){
+            window_qc -= qcs.at(i-w);
+            window_wg -= wgs.at(i-w);
+        }
+
+        int above_n = layer_n - w; //samples of the layer above the window
+        if(above_n < w)
+            continue;
+        double above_qc = (layer_qc - window_qc) / above_n;
+        double above_wg = (layer_wg - window_wg) / above_n;
+        double qc_tolerance = settings.qcTolerance * qAbs(above_qc);
+        if((qAbs(window_qc / w - above_qc) <= qc_tolerance) && (qAbs(window_wg / w - above_wg) <= settings.wgTolerance))
+            continue;
+
+        //the change is somewhere in the window, split where the sum of the
+        //deviations (relative to the tolerances) below the split is largest
+        int split = i;
+        double best = -std::numeric_limits<double>::max();
+        double cusum = 0.;
+        for(int j=i; j>i-w; j--){
+            double dqc = (qc_tolerance > 0.) ? qAbs(qcs.at(j) - above_qc) / qc_tolerance : 0.;
+            double dwg = (settings.wgTolerance > 0.) ? qAbs(wgs.at(j) - above_wg) / settings.wgTolerance : 0.;
+            cusum += qMax(dqc, dwg) - 1.;
+            if(cusum > best){
+                best = cusum;
+                split = j;
+            }
+        }
+        if(ztop - zs.at(split-1) < settings.minThickness)
+            continue;
+
+        double new_qc = 0., new_wg = 0.;
+        for(int j=split; j<=i; j++){
+            new_qc += qcs.at(j);
+            new_wg += wgs.at(j);
+        }
+        ztops.append(ztop);
+        zbottoms.append(zs.at(split-1));
+        sumQcs.append(layer_qc - new_qc);
+        sumWgs.append(layer_wg - new_wg);
+        counts.append(layer_n - (i - split + 1));
+        ztop = zs.at(split-1);
+        layer_qc = new_qc;
+        layer_wg = new_wg;
+        layer_n = i - split + 1;
+    }
+
+    if((ztops.count() > 0) && (ztop - zs.at(n-1) < settings.minThickness)){
+        int last = ztops.count() - 1;
+        zbottoms[last] = zs.at(n-1);
+        sumQcs[last] += layer_qc;
+        sumWgs[last] += layer_wg;
+        counts[last] += layer_n;
+    }else{
+        ztops.append(ztop);
+        zbottoms.append(zs.at(n-1));
+        sumQcs.append(layer_qc);
+        sumWgs.append(layer_wg);
+        counts.append(layer_n);
+    }
+
+    int numLayers = ztops.count();
+    for(int i=0; i<numLayers; i++){
+        sumQcs[i] /= counts.at(i);
+        sumWgs[i] /= counts.at(i);
+    }
+    QVector<int> soilTypeIds(numLayers);
+    classifier->classifyToSoilTypeIds(sumQcs.constData(), sumWgs.constData(), numLayers, soilTypeIds.data());
+
+    for(int i=0; i<numLayers; i++){
+        int j = i;
+        while((j + 1 < numLayers) && (soilTypeIds.at(j + 1) == soilTypeIds.at(i)))
+            j++;
+        vsoil.addSoilLayer(ztops.at(i), zbottoms.at(j), soilTypeIds.at(i));
+        i = j;
+    }
+}
+
 
 
 
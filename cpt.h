@@ -6,8 +6,12 @@
 #include <QDateTime>
 #include <QList>
 #include <QStringList>
+#include <QVector>
+#include <QBitArray>
 
 #include "vsoil.h"
+#include "cptseries.h"
+#include "soilclassifier.h"
 
 struct sCPTMetaData{
     int id;
@@ -20,24 +24,45 @@ struct sCPTMetaData{
     QString fileName;
     QDateTime date;
     QString name;
+    int vsoilId; //the vsoil generated from this cpt, -1 if unknown
+};
+Q_DECLARE_METATYPE(sCPTMetaData)
+
+/*
+    Settings for generateVSoilBySegments
+ */
+struct sSegmentation{
+    int window;          //number of samples in the rolling window
+    double minThickness; //minimum thickness of a layer [m]
+    double qcTolerance;  //relative change of the average qc that starts a new layer
+    double wgTolerance;  //absolute change of the average wg [%] that starts a new layer
 };
 
 class CPT : public QObject
 {
     Q_OBJECT
 public:
+    enum Interpolation {
+        Step,  //value of the first sample below z
+        Linear //linear between the samples above and below z
+    };
+
     explicit CPT(QObject *parent = 0);
     ~CPT();
     QByteArray dataAsQByteArray();
 
-    double getQcAt(double z);
-    double getWgAt(double z);
-    double getPwAt(double z);
+    double getQcAt(double z, Interpolation method = Step, bool *ok = 0) const;
+    double getWgAt(double z, Interpolation method = Step, bool *ok = 0) const;
+    double getPwAt(double z, Interpolation method = Step, bool *ok = 0) const;
+    double valueAt(CPTSeries::Column column, double z, Interpolation method = Step, bool *ok = 0) const;
+    int resampleTo(const QVector<double> &depths, CPTSeries &result, QBitArray &inRange, Interpolation method = Linear) const;
 
-    //void blobToData(QString data);
+    bool blobToData(const QByteArray &data);
 
     bool readFromFile(const QString filename, QStringList &log);
+    double parseThroughput() { return m_parseThroughput; } //MB/s of the last readFromFile
     sCPTMetaData metaData() { return m_metaData; }
+    void setMetaData(const sCPTMetaData &metaData) { m_metaData = metaData; }
 
     int id() { return m_metaData.id; }
     double x() { return m_metaData.x; }
@@ -58,21 +83,26 @@ public:
     void setLatitude(double lat) { m_metaData.latitude = lat; }
     void setLongitude(double lon) {m_metaData.longitude = lon; }
     void setName(QString name) {m_metaData.name = name; }
+    void setVSoilId(int id) { m_metaData.vsoilId = id; }
 
-    void generateVSoil(VSoil &vsoil, double minInterval);
+    void generateVSoil(VSoil &vsoil, double minInterval, const SoilClassifier *classifier = 0);
+    void generateVSoilBySegments(VSoil &vsoil, const sSegmentation &settings, const SoilClassifier *classifier = 0);
+    static sSegmentation defaultSegmentation();
 
-    QList<double>* z() { return m_z; }
-    QList<double>* qc() { return m_qc; }
-    QList<double>* pw() { return m_pw; }
-    QList<double>* wg() { return m_wg; }
+    const CPTSeries &series() const { return m_series; }
+    CPTSeries &series() { return m_series; }
+    CPTColumn z() const { return m_series.z(); }
+    CPTColumn qc() const { return m_series.qc(); }
+    CPTColumn pw() const { return m_series.pw(); }
+    CPTColumn wg() const { return m_series.wg(); }
+    void setSinglePrecision(bool singlePrecision) { m_series.setSinglePrecision(singlePrecision); } //store the series as float to save memory
 
 private:
     sCPTMetaData m_metaData;
 
-    QList<double> *m_z;  //all z points
-    QList<double> *m_qc; //all qc points
-    QList<double> *m_pw; //all pw points
-    QList<double> *m_wg; //all wg points
+    CPTSeries m_series; //all z, qc, pw and wg points
+
+    double m_parseThroughput;
 
 signals:
     
@@ -0,0 +1,136 @@
+#include "cptseries.h"
+
+#include <string.h>
+
+CPTSeries::CPTSeries(bool singlePrecision)
+{
+    m_count = 0;
+    m_capacity = 0;
+    m_float = singlePrecision;
+}
+
+/*
+    Moves the columns into a new buffer with room for capacity values per
+    column, converting the values if the precision changes
+ */
+void CPTSeries::reallocate(int capacity, bool singlePrecision)
+{
+    int newSize = singlePrecision ? int(sizeof(float)) : int(sizeof(double));
+    QByteArray buffer(NumColumns * capacity * newSize, Qt::Uninitialized);
+    if(m_count > 0){
+        const char *src = m_buffer.constData();
+        char *dst = buffer.data();
+        int oldSize = valueSize();
+        for(int c=0; c<NumColumns; c++){
+            const char *from = src + c * m_capacity * oldSize;
+            char *to = dst + c * capacity * newSize;
+            if(singlePrecision == m_float){
+                memcpy(to, from, m_count * newSize);
+            }else if(singlePrecision){
+                const double *d = reinterpret_cast<const double*>(from);
+                float *f = reinterpret_cast<float*>(to);
+                for(int i=0; i<m_count; i++) f[i] = float(d[i]);
+            }else{
+                const float *f = reinterpret_cast<const float*>(from);
+                double *d = reinterpret_cast<double*>(to);
+                for(int i=0; i<m_count; i++) d[i] = double(f[i]);
+            }
+        }
+    }
+    m_buffer = buffer;
+    m_capacity = capacity;
+    m_float = singlePrecision;
+}
+
+void CPTSeries::setSinglePrecision(bool singlePrecision)
+{
+    if(singlePrecision != m_float)
+        reallocate(m_capacity, singlePrecision);
+}
+
+void CPTSeries::reserve(int capacity)
+{
+    if(capacity > m_capacity)
+        reallocate(capacity, m_float);
+}
+
+/*
+    Sets the number of values per column, new values are 0
+ */
+void CPTSeries::resize(int count)
+{
+    count = qMax(0, count);
+    reserve(count);
+    if(count > m_count){
+        char *data = m_buffer.data();
+        int size = valueSize();
+        for(int c=0; c<NumColumns; c++)
+            memset(data + (c * m_capacity + m_count) * size, 0, (count - m_count) * size);
+    }
+    m_count = count;
+}
+
+//releases the memory that is not used
+void CPTSeries::squeeze()
+{
+    if(m_capacity > m_count)
+        reallocate(m_count, m_float);
+}
+
+void CPTSeries::clear()
+{
+    m_buffer.clear();
+    m_count = 0;
+    m_capacity = 0;
+}
+
+void CPTSeries::append(double z, double qc, double pw, double wg)
+{
+    if(m_count == m_capacity)
+        reallocate(qMax(64, 2 * m_capacity), m_float);
+    char *data = m_buffer.data();
+    if(m_float){
+        float *f = reinterpret_cast<float*>(data);
+        f[m_count] = float(z);
+        f[m_capacity + m_count] = float(qc);
+        f[2 * m_capacity + m_count] = float(pw);
+        f[3 * m_capacity + m_count] = float(wg);
+    }else{
+        double *d = reinterpret_cast<double*>(data);
+        d[m_count] = z;
+        d[m_capacity + m_count] = qc;
+        d[2 * m_capacity + m_count] = pw;
+        d[3 * m_capacity + m_count] = wg;
+    }
+    m_count++;
+}
+
+void CPTSeries::setValue(Column c, int i, double value)
+{
+    char *data = m_buffer.data();
+    if(m_float)
+        reinterpret_cast<float*>(data)[c * m_capacity + i] = float(value);
+    else
+        reinterpret_cast<double*>(data)[c * m_capacity + i] = value;
+}
+
+CPTColumn CPTSeries::column(Column c) const
+{
+    if(m_capacity == 0)
+        return CPTColumn();
+    return CPTColumn(m_buffer.constData() + c * m_capacity * valueSize(), m_count, m_float);
+}
+
+double *CPTSeries::doubleColumn(Column c)
+{
+    if(m_float || m_capacity == 0)
+        return NULL;
+    return reinterpret_cast<double*>(m_buffer.data()) + c * m_capacity;
+}
+
+float *CPTSeries::floatColumn(Column c)
+{
+    if(!m_float || m_capacity == 0)
+        return NULL;
+    return reinterpret_cast<float*>(m_buffer.data()) + c * m_capacity;
+}
@@ -0,0 +1,81 @@
+#ifndef CPTSERIES_H
+#define CPTSERIES_H
+
+#include <QByteArray>
+
+/*
+    Read-only view on one column of a CPTSeries. It points into the buffer
+    of the series so it is only valid as long as the series is not changed.
+ */
+class CPTColumn
+{
+public:
+    CPTColumn() : m_data(NULL), m_count(0), m_isFloat(false) {}
+    CPTColumn(const void *data, int count, bool isFloat) : m_data(data), m_count(count), m_isFloat(isFloat) {}
+
+    int count() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+    double at(int i) const { return m_isFloat ? double(static_cast<const float*>(m_data)[i]) : static_cast<const double*>(m_data)[i]; }
+    double operator[](int i) const { return at(i); }
+    double first() const { return at(0); }
+    double last() const { return at(m_count - 1); }
+
+    bool isFloat() const { return m_isFloat; }
+    const float *floatData() const { return m_isFloat ? static_cast<const float*>(m_data) : NULL; }
+    const double *doubleData() const { return m_isFloat ? NULL : static_cast<const double*>(m_data); }
+
+private:
+    const void *m_data;
+    int m_count;
+    bool m_isFloat;
+};
+
+/*
+    The measurements of a CPT (z, qc, pw and wg) in one owned buffer with the
+    columns one after the other. The values are stored as double or, to save
+    memory, as float. Copying is cheap, the buffer is shared until one of the
+    copies is changed.
+ */
+class CPTSeries
+{
+public:
+    enum Column { Z = 0, Qc, Pw, Wg, NumColumns };
+
+    explicit CPTSeries(bool singlePrecision = false);
+
+    int count() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+    int capacity() const { return m_capacity; }
+    bool isSinglePrecision() const { return m_float; }
+    void setSinglePrecision(bool singlePrecision);
+
+    void reserve(int capacity);
+    void resize(int count);
+    void squeeze();
+    void clear();
+
+    void append(double z, double qc, double pw, double wg);
+    void setValue(Column c, int i, double value);
+    double value(Column c, int i) const { return column(c).at(i); }
+
+    CPTColumn column(Column c) const;
+    double *doubleColumn(Column c); //NULL if the series is stored as float
+    float *floatColumn(Column c);   //NULL if the series is stored as double
+    CPTColumn z() const { return column(Z); }
+    CPTColumn qc() const { return column(Qc); }
+    CPTColumn pw() const { return column(Pw); }
+    CPTColumn wg() const { return column(Wg); }
+
+    qint64 memoryUsage() const { return m_buffer.capacity(); } //bytes
+
+private:
+    QByteArray m_buffer; //NumColumns blocks of m_capacity values
+    int m_count;
+    int m_capacity;
+    bool m_float;
+
+    int valueSize() const { return m_float ? int(sizeof(float)) : int(sizeof(double)); }
+    void reallocate(int capacity, bool singlePrecision);
+};
+
+#endif // CPTSERIES_H
@@ -1,8 +1,10 @@
-#include <QMessageBox>
 #include <QDebug>
 #include <QDir>
-#include <QProgressDialog>
 #include <QXmlStreamWriter>
+#include <QtConcurrentMap>
+#include <QThread>
+#include <QCoreApplication>
+#include <algorithm>
 
 #include "datastore.h"
 #include "cpt.h"
@@ -15,10 +17,33 @@ DataStore::DataStore(QObject *parent) :
     //init a database
     m_db = new DBAdapter(NULL);
     m_dataLoaded = false;
+    m_importBatchSize = 64;
+    m_layerPropertiesRevision = 0;
+    m_soilClassifier = QSharedPointer<SoilClassifier>(new CUR162Classifier());
+    m_segmentCPTs = false;
+    m_segmentation = CPT::defaultSegmentation();
+    m_cptViewIndexValid = false;
+    m_vsoilViewIndexValid = false;
+    m_loader = NULL;
+    m_loaderThread = NULL;
+    m_snapshotFile = NULL;
 }
 
 DataStore::~DataStore()
 {
+    //stop a background load. The results that are still queued carry
+    //soiltypes and vsoils, deliver them so loaderFinished (canceled) deletes
+    //them with the rest of the partial load
+    if(m_loader){
+        m_loader->cancel();
+        m_loaderThread->quit();
+        m_loaderThread->wait();
+        QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    }
+    if(m_loader){ //the loader did not report that it finished
+        delete m_loader;
+        delete m_loaderThread;
+    }
     //close the database and cleanup
     m_db->closeDB();
     delete m_db;
@@ -27,104 +52,464 @@ DataStore::~DataStore()
         delete m_geoProfile2Ds[i];
     }
     m_geoProfile2Ds.clear();
+    //the facades, their records in m_entities go with the datastore
+    deleteVSoilFacades();
+    deleteSoilTypeFacades();
+    //the view indexes may use the mapped snapshot
+    m_cptViewIndex.clear();
+    m_vsoilViewIndex.clear();
+    delete m_snapshotFile;
 }
 
 bool DataStore::loadDataNonUI(QString fileName)
 {
+    if(m_loader || m_db->isOpen())
+        return false;
     m_dataLoaded = m_db->openDB(fileName);
     m_fileName = fileName;
     m_db->getAllCPTs(m_cptsMetaData);
-    m_db->getAllSoilTypes(m_soilTypes);
-    m_db->getAllVSoils(m_vsoils);
+    loadEntities();
+    updateSoilTypeRegistry();
+    updateVSoilRegistry();
+    invalidateSpatialIndex();
     return m_dataLoaded;
 }
 
-void DataStore::loadData(QString fileName)
+/*
+  (Re)reads the soiltypes and vsoils of the open database into m_entities and
+  puts a SoilType and VSoil around every record, see createEntityFacades.
+  Call updateSoilTypeRegistry and updateVSoilRegistry after it.
+  */
+void DataStore::loadEntities()
+{
+    loadSoilTypeEntities();
+    loadVSoilEntities();
+}
+
+//the soiltypes part of loadEntities, unsaved changes of the soiltypes are lost
+void DataStore::loadSoilTypeEntities()
+{
+    deleteSoilTypeFacades();
+    m_entities.soilTypes().clear();
+    m_db->getAllSoilTypes(m_entities);
+    createSoilTypeFacades();
+}
+
+//the vsoils part of loadEntities, unsaved changes of the vsoils are lost
+void DataStore::loadVSoilEntities()
+{
+    deleteVSoilFacades();
+    m_entities.vsoils().clear();
+    m_db->getAllVSoils(m_entities);
+    createVSoilFacades();
+}
+
+/*
+  Fills m_soilTypes and m_vsoils with facades on the records in m_entities
+  (in the order of the records), the records stay in the store. The facades
+  of an earlier load are deleted.
+  */
+void DataStore::createEntityFacades()
+{
+    createSoilTypeFacades();
+    createVSoilFacades();
+}
+
+void DataStore::createSoilTypeFacades()
+{
+    deleteSoilTypeFacades();
+    m_soilTypes.reserve(m_entities.soilTypes().count());
+    for(int slot=0; slot<m_entities.soilTypes().slotCount(); slot++){
+        sSoilTypeRecord *r = m_entities.soilTypes().atSlot(slot);
+        if(r)
+            m_soilTypes.append(new SoilType(r));
+    }
+}
+
+void DataStore::createVSoilFacades()
+{
+    deleteVSoilFacades();
+    m_vsoils.reserve(m_entities.vsoils().count());
+    for(int slot=0; slot<m_entities.vsoils().slotCount(); slot++){
+        sVSoilRecord *r = m_entities.vsoils().atSlot(slot);
+        if(r)
+            m_vsoils.append(new VSoil(r));
+    }
+}
+
+//the registries still point to the deleted objects, update them after a new load
+void DataStore::deleteSoilTypeFacades()
+{
+    qDeleteAll(m_soilTypes);
+    m_soilTypes.clear();
+}
+
+void DataStore::deleteVSoilFacades()
+{
+    qDeleteAll(m_vsoils);
+    m_vsoils.clear();
+}
+
+/*
+  Opens the database and loads it on a worker thread with its own
+  connection. The data becomes available in parts, the signals
+  soilTypesLoaded, cptsLoaded and vsoilsLoaded (once per chunk) are emitted
+  after every part is added; loadProgress reports the number of rows read.
+  loadFinished is emitted at the end, use cancelLoad to stop loading.
+  Returns false if the database could not be opened or is already loading.
+  */
+bool DataStore::loadDataAsync(QString fileName)
+{
+    if(m_loader || m_db->isOpen())
+        return false;
+    if(!m_db->openDB(fileName))
+        return false;
+    m_fileName = fileName;
+    m_dataLoaded = false;
+
+    qRegisterMetaType<QList<SoilType*> >("QList<SoilType*>");
+    qRegisterMetaType<QList<sCPTMetaData> >("QList<sCPTMetaData>");
+    qRegisterMetaType<QList<VSoil*> >("QList<VSoil*>");
+
+    m_loaderThread = new QThread();
+    m_loader = new DataStoreLoader(fileName, thread());
+    m_loader->moveToThread(m_loaderThread);
+    connect(m_loaderThread, SIGNAL(started()), m_loader, SLOT(load()));
+    connect(m_loader, SIGNAL(progress(int,int)), this, SIGNAL(loadProgress(int,int)));
+    connect(m_loader, SIGNAL(soilTypesLoaded(QList<SoilType*>)), this, SLOT(loaderSoilTypesLoaded(QList<SoilType*>)));
+    connect(m_loader, SIGNAL(cptsLoaded(QList<sCPTMetaData>)), this, SLOT(loaderCPTsLoaded(QList<sCPTMetaData>)));
+    connect(m_loader, SIGNAL(vsoilsLoaded(QList<VSoil*>)), this, SLOT(loaderVSoilsLoaded(QList<VSoil*>)));
+    connect(m_loader, SIGNAL(finished(bool,bool)), this, SLOT(loaderFinished(bool,bool)));
+    m_loaderThread->start();
+    return true;
+}
+
+/*
+  Stops loadDataAsync, the data that was already added is removed and the
+  database is closed when the loader has stopped (loadFinished(false))
+  */
+void DataStore::cancelLoad()
+{
+    if(m_loader)
+        m_loader->cancel();
+}
+
+void DataStore::loaderSoilTypesLoaded(QList<SoilType *> soilTypes)
+{
+    m_soilTypes = soilTypes;
+    updateSoilTypeRegistry();
+    invalidateLayerProperties();
+    emit soilTypesLoaded();
+}
+
+void DataStore::loaderCPTsLoaded(QList<sCPTMetaData> cpts)
+{
+    m_cptsMetaData = cpts;
+    invalidateSpatialIndex();
+    emit cptsLoaded();
+}
+
+void DataStore::loaderVSoilsLoaded(QList<VSoil *> vsoils)
+{
+    m_vsoils.append(vsoils);
+    //the first vsoil with an id wins, like in updateVSoilRegistry
+    for(int i=0; i<vsoils.count(); i++)
+        if(!m_vsoilsById.contains(vsoils.at(i)->id()))
+            m_vsoilsById.insert(vsoils.at(i)->id(), vsoils.at(i));
+    invalidateSpatialIndex();
+    emit vsoilsLoaded(m_vsoils.count());
+}
+
+void DataStore::loaderFinished(bool ok, bool canceled)
+{
+    m_loaderThread->quit();
+    m_loaderThread->wait();
+    delete m_loader;
+    m_loader = NULL;
+    delete m_loaderThread;
+    m_loaderThread = NULL;
+
+    if(canceled || !ok){
+        deleteVSoilFacades();
+        deleteSoilTypeFacades();
+        m_cptsMetaData.clear();
+        updateVSoilRegistry();
+        updateSoilTypeRegistry();
+        invalidateSpatialIndex();
+        m_db->closeDB();
+    }
+    m_dataLoaded = ok && !canceled;
+    emit loadFinished(m_dataLoaded);
+}
+
+/*
+  Loads the data from a snapshot of the database (see writeSnapshot) instead
+  of the database itself, the layers do not have to be parsed and the view
+  indexes are used from the mapped file. The database is opened for the
+  changes. Returns false (and loads nothing) if there is no snapshot or if
+  the database changed after the snapshot was written.
+  */
+bool DataStore::loadDataFromSnapshot(QString fileName, QString snapshotFileName, QStringList &log)
+{
+    if(m_loader || m_db->isOpen() || m_snapshotFile)
+        return false;
+    SnapshotFile *snapshot = new SnapshotFile();
+    if(!snapshot->open(snapshotFileName, fileName, log) || !m_db->openDB(fileName)){
+        delete snapshot;
+        return false;
+    }
+    //the records live in m_entities, the soiltypes and vsoils are facades on them
+    if(!m_entities.loadFromSnapshot(*snapshot, log)){
+        m_db->closeDB();
+        delete snapshot;
+        return false;
+    }
+    m_snapshotFile = snapshot;
+    m_fileName = fileName;
+    m_cptsMetaData = m_entities.cpts().toList();
+    createEntityFacades();
+
+    updateSoilTypeRegistry();
+    updateVSoilRegistry();
+    invalidateSpatialIndex();
+    //the view indexes were written for the same order of cpts and vsoils,
+    //they hold indexes in m_cptsMetaData and m_vsoils so only use them if
+    //every record made it, else they are rebuilt on first use
+    if(m_cptsMetaData.count() == snapshot->cptCount() && m_vsoils.count() == snapshot->vsoilCount()){
+        snapshot->attachViewIndexes(m_cptViewIndex, m_vsoilViewIndex);
+        m_cptViewIndexValid = true;
+        m_vsoilViewIndexValid = true;
+    }else{
+        log.append("The view indexes of the snapshot do not match the loaded data, they are rebuilt.");
+    }
+    m_dataLoaded = true;
+    return true;
+}
+
+/*
+  Writes a snapshot of the loaded data for loadDataFromSnapshot. The
+  snapshot belongs to the state of the database file so this fails if there
+  are unsaved changes, call saveChanges and saveSoilTypes first.
+  */
+bool DataStore::writeSnapshot(QString snapshotFileName, QStringList &log)
+{
+    if(!m_dataLoaded){
+        log.append("Trying to write a snapshot with closed database.");
+        return false;
+    }
+    int numChanged = 0;
+    for(int i=0; i<m_vsoils.count(); i++)
+        if(m_vsoils.at(i)->dataChanged())
+            numChanged++;
+    for(int i=0; i<m_soilTypes.count(); i++)
+        if(m_soilTypes.at(i)->dataChanged())
+            numChanged++;
+    if(numChanged > 0){
+        log.append(QString("Not writing the snapshot, %1 vsoils or soiltypes have unsaved changes.").arg(numChanged));
+        return false;
+    }
+    updateViewIndexes();
+    return SnapshotFile::write(snapshotFileName, m_fileName, m_cptsMetaData, m_soilTypes, m_vsoils,
+                               m_cptViewIndex, m_vsoilViewIndex, log);
+}
+
+/*
+  Loads the database, problems are reported with the error signal and the
+  progress with loadDataProgress (4 steps). See DataStoreDialogs to show both
+  in a GUI.
+  */
+bool DataStore::loadData(QString fileName)
 {
     //check if the database is open
     if (m_db->isOpen()){
-        QMessageBox::warning(
-            NULL,
-            tr("qBB3D"),
-            tr("You need to close the current database first.") );
-        return;
+        emit error(tr("You need to close the current database first."));
+        return false;
     }
     //now open the file
     if (!m_db->openDB(fileName)){
-        QMessageBox::critical(
-            NULL,
-            tr("qBB3D"),
-            tr("Could not open database file.") );
-        return;
+        emit error(tr("Could not open database file."));
+        return false;
     }
     //read all information into memory
     m_fileName = fileName;
 
-    QProgressDialog progress("Reading database file...", tr("Cancel"), 0, 4, NULL);
-    progress.setCancelButton(NULL);
-    progress.show();
-    progress.setWindowModality(Qt::WindowModal);
-    progress.setValue(1);
+    emit loadDataProgress(1, 4);
     m_db->getAllCPTs(m_cptsMetaData);
-    progress.setValue(2);
-    m_db->getAllSoilTypes(m_soilTypes);
-    progress.setValue(3);
-    m_db->getAllVSoils(m_vsoils);
+    emit loadDataProgress(2, 4);
+    loadSoilTypeEntities();
+    emit loadDataProgress(3, 4);
+    loadVSoilEntities();
+    updateSoilTypeRegistry();
+    updateVSoilRegistry();
+    invalidateSpatialIndex();
+    emit loadDataProgress(4, 4);
     m_dataLoaded = true;
+    return true;
 }
 
-QList<VSoil*> DataStore::getVisibleVSoils(QRectF boundary)
+/*
+  (Re)builds the r-trees that are used for the viewport queries
+  */
+void DataStore::updateViewIndexes()
 {
-    QList<VSoil *> result;
-    foreach (VSoil *vs, m_vsoils){
-        if ((vs->latitude() >= boundary.bottom()) && (vs->latitude() <= boundary.top()) &&
-            (vs->longitude() >= boundary.left()) && (vs->longitude() <= boundary.right())){
-             result.append(vs);
+    if(!m_cptViewIndexValid){
+        QVector<sIndexPoint> points(m_cptsMetaData.count());
+        for(int i=0; i<m_cptsMetaData.count(); i++){
+            points[i].x = m_cptsMetaData.at(i).longitude;
+            points[i].y = m_cptsMetaData.at(i).latitude;
+            points[i].index = i;
         }
+        m_cptViewIndex.build(points);
+        m_cptViewIndexValid = true;
     }
+    if(!m_vsoilViewIndexValid){
+        QVector<sIndexPoint> points(m_vsoils.count());
+        for(int i=0; i<m_vsoils.count(); i++){
+            points[i].x = m_vsoils[i]->longitude();
+            points[i].y = m_vsoils[i]->latitude();
+            points[i].index = i;
+        }
+        m_vsoilViewIndex.build(points);
+        m_vsoilViewIndexValid = true;
+    }
+}
+
+/*
+  Returns the vsoils within the boundary (lon = x, lat = y, top >= bottom).
+  With maxResults > 0 the result is thinned out to at most maxResults vsoils
+  */
+QList<VSoil*> DataStore::getVisibleVSoils(QRectF boundary, int maxResults)
+{
+    updateViewIndexes();
+    QList<int> indexes;
+    m_vsoilViewIndex.query(boundary.left(), boundary.bottom(), boundary.right(), boundary.top(), indexes, maxResults);
+    QList<VSoil *> result;
+    result.reserve(indexes.count());
+    for(int i=0; i<indexes.count(); i++)
+        result.append(m_vsoils[indexes[i]]);
     return result;
 }
 
-QList<sCPTMetaData> DataStore::getVisibleCPTs(QRectF boundary)
+/*
+  Returns the indexes of the cpts within the boundary, use cptMetaDataAt
+  to get to the metadata without copying it.
+  With maxResults > 0 the result is thinned out to at most maxResults cpts
+  */
+QList<int> DataStore::getVisibleCPTIndexes(QRectF boundary, int maxResults)
 {
+    updateViewIndexes();
+    QList<int> indexes;
+    m_cptViewIndex.query(boundary.left(), boundary.bottom(), boundary.right(), boundary.top(), indexes, maxResults);
+    return indexes;
+}
+
+QList<sCPTMetaData> DataStore::getVisibleCPTs(QRectF boundary, int maxResults)
+{
+    QList<int> indexes = getVisibleCPTIndexes(boundary, maxResults);
     QList<sCPTMetaData> result;
-    foreach (sCPTMetaData md, m_cptsMetaData){
-        if ((md.latitude >= boundary.bottom()) && (md.latitude <= boundary.top()) &&
-            (md.longitude >= boundary.left()) && (md.longitude <= boundary.right())){
-             result.append(md);
-        }
-    }
+    result.reserve(indexes.count());
+    for(int i=0; i<indexes.count(); i++)
+        result.append(m_cptsMetaData.at(indexes[i]));
     return result;
 }
 
+/*
+  (Re)builds the snapshot of the enabled vsoils with its kd-tree if the
+  vsoils, their location or their enabled state changed since the last build
+  */
+void DataStore::updateVSoilSnapshot()
+{
+    if(!m_vsoilSnapshot.isNull())
+        return;
+    m_vsoilSnapshot = QSharedPointer<const VSoilSnapshot>(new VSoilSnapshot(m_vsoils));
+}
+
 //return the vsoil.id with the coordinates closest to the given point xy
 //filter by enabled ones
+//if two vsoils are at the same distance the first one in the list is used
 int DataStore::getVSoilIdClosestTo(QPointF xy)
 {
-    double dlmin = 1.e9;
-    int idx = -1;
-    for(int i=0; i<m_vsoils.count(); i++){
-        if(m_vsoils[i]->isEnabled()){
-            double dx = xy.x() - m_vsoils[i]->x();
-            double dy = xy.y() - m_vsoils[i]->y();
-            double dl = dx * dx + dy * dy;
-            if(dl < dlmin){
-                idx = m_vsoils[i]->id();
-                dlmin = dl;
-            }
-        }
-    }
-    return idx;
+    updateVSoilSnapshot();
+    int idx = m_vsoilSnapshot->nearest(xy);
+    if(idx == -1)
+        return -1;
+    return m_vsoilSnapshot->at(idx).id;
+}
+
+//return the ids of the k enabled vsoils closest to xy, closest first
+QList<int> DataStore::getVSoilIdsClosestTo(QPointF xy, int k)
+{
+    updateVSoilSnapshot();
+    QList<int> indexes, result;
+    m_vsoilSnapshot->kNearest(xy, k, indexes);
+    for(int i=0; i<indexes.count(); i++)
+        result.append(m_vsoilSnapshot->at(indexes[i]).id);
+    return result;
 }
 
+//return the ids of the enabled vsoils within radius [m] of xy
+QList<int> DataStore::getVSoilIdsWithin(QPointF xy, double radius)
+{
+    updateVSoilSnapshot();
+    QList<int> indexes, result;
+    m_vsoilSnapshot->withinRadius(xy, radius, indexes);
+    for(int i=0; i<indexes.count(); i++)
+        result.append(m_vsoilSnapshot->at(indexes[i]).id);
+    return result;
+}
+
+/*
+  The result of reading and classifying one GEF file, see sCPTReader
+  */
+struct sCPTImport{
+    QString fileName;
+    CPT *cpt;
+    VSoil *vsoil;
+    bool ok;
+    QStringList log;
+};
+
+/*
+  First stage of the import pipeline, runs on the worker threads.
+  Reads the file and generates the vsoil, nothing is done with the database here
+  */
+struct sCPTReader{
+    typedef sCPTImport result_type;
+    QSharedPointer<const SoilClassifier> classifier;
+    bool segmented;
+    sSegmentation segmentation;
+
+    sCPTImport operator()(const QString &fileName) const
+    {
+        sCPTImport result;
+        result.fileName = fileName;
+        result.cpt = new CPT();
+        result.vsoil = new VSoil();
+        result.vsoil->setName("imported"); //TODO: set to cpt name
+        result.ok = result.cpt->readFromFile(fileName, result.log);
+        if(result.ok && segmented)
+            result.cpt->generateVSoilBySegments(*result.vsoil, segmentation, classifier.data());
+        else if(result.ok)
+            result.cpt->generateVSoil(*result.vsoil, 0.1, classifier.data()); //TODO: 0.1 vast waarde?
+        return result;
+    }
+};
+
 /*
   Import CPTs from a given path,
   !NOTE!
   The CPT is read entirely and put into the database
   After that only the metadata is saved to use in this program
   To load the data from the cpt again you need to call it explicitly!
+
+  The files are read and classified in batches on the global thread pool
+  while the previous batch is written to the database on the calling thread.
+  The database stage handles the files in the original order so the ids,
+  the log and the progress signals are the same as for a serial import.
+  Returns false if a cpt or its vsoil could not be added to the database,
+  that cpt is skipped.
   */
-void DataStore::importCPTS(QString path, QStringList &log)
+bool DataStore::importCPTS(QString path, QStringList &log)
 {
     log.append("LOGBOOK import CPT files");
 
@@ -139,39 +524,78 @@ void DataStore::importCPTS(QString path, QStringList &log)
     }
     emit sendTotalCPT(files.count()); //send a signal to the dialog with the number of found cpt's
 
-    //add cpt one by one
-    for(int i=0; i<files.count(); i++){
-        emit importingNextCPT(i);
-        CPT *cpt = new CPT();
-        VSoil vs;
-        vs.setName("imported"); //TODO: set to cpt name
-        if(!cpt->readFromFile(files[i], log)){
-            log.append(QString("SKIPPED file %1 because of previous file read error.").arg(files[i]));
-        }else{
-            //check if there's another entry in the database with the same xy coords
-            if (m_db->isUniqueCPT(QPointF(cpt->x(), cpt->y()))){ //if so.. add it to the database
-                cpt->generateVSoil(vs, 0.1); //TODO: 0.1 vast waarde?
-                m_db->addCPT(cpt, vs.id(), err);
-                if(err.isValid()){
-                    qDebug() << "DBERROR: %1" << err;
-                    log.append(QString("SKIPPED file %1 because of database error %2").arg(files[i]).arg(err.text()));
-                }
-                m_db->addVSoil(vs, err);
-                if(err.isValid()){
-                    qDebug() << "DBERROR: %1" << err;
-                    log.append(QString("SKIPPED file %1 because of database error %2").arg(files[i]).arg(err.text()));
-                }
+    //all inserts go through one transaction with reused statements
+    bool result = true;
+    m_db->beginBulkInsert();
+
+    //start reading the first batch
+    sCPTReader reader;
+    reader.classifier = m_soilClassifier;
+    reader.segmented = m_segmentCPTs;
+    reader.segmentation = m_segmentation;
+    QFuture<sCPTImport> pending;
+    if(files.count() > 0)
+        pending = QtConcurrent::mapped(files.mid(0, m_importBatchSize), reader);
+
+    for(int start=0; start<files.count(); start+=m_importBatchSize){
+        pending.waitForFinished();
+        QList<sCPTImport> batch = pending.results();
+        //read the next batch while this one goes into the database
+        if(start + m_importBatchSize < files.count())
+            pending = QtConcurrent::mapped(files.mid(start + m_importBatchSize, m_importBatchSize), reader);
+
+        //add cpt one by one
+        for(int j=0; j<batch.count(); j++){
+            int i = start + j;
+            emit importingNextCPT(i);
+            CPT *cpt = batch[j].cpt;
+            VSoil *vs = batch[j].vsoil;
+            log.append(batch[j].log);
+            if(!batch[j].ok){
+                log.append(QString("SKIPPED file %1 because of previous file read error.").arg(files[i]));
             }else{
-                log.append(QString("SKIPPED file %1 because the x and y coordinate are not unique.").arg(files[i]));
+                //check if there's another entry in the database with the same xy coords
+                if (m_db->isUniqueCPT(QPointF(cpt->x(), cpt->y()))){ //if so.. add it to the database
+                    //the vsoil goes first so the cpt can refer to its id
+                    m_db->addVSoil(*vs, err);
+                    if(err.isValid()){
+                        qDebug() << "DBERROR: %1" << err;
+                        log.append(QString("SKIPPED file %1 because of database error %2").arg(files[i]).arg(err.text()));
+                        batch[j].ok = false;
+                        result = false;
+                    }else{
+                        //remember the generated layers so regenerateCPTVSoils can tell edits apart
+                        m_db->setGeneratedVSoilData(vs->id(), vs->dataAsQByteArray(), err);
+                        if(err.isValid())
+                            qDebug() << "DBERROR:" << err;
+                        cpt->setVSoilId(vs->id());
+                        m_db->addCPT(cpt, vs->id(), err);
+                        if(err.isValid()){
+                            qDebug() << "DBERROR: %1" << err;
+                            log.append(QString("SKIPPED file %1 because of database error %2").arg(files[i]).arg(err.text()));
+                            batch[j].ok = false;
+                            result = false;
+                        }
+                    }
+                }else{
+                    log.append(QString("SKIPPED file %1 because the x and y coordinate are not unique.").arg(files[i]));
+                    batch[j].ok = false;
+                }
             }
-        }        
-        m_cptsMetaData.append(cpt->metaData());
-        delete cpt; //be sure to erase all stuff
+            //only the cpts that made it into the database
+            if(batch[j].ok)
+                m_cptsMetaData.append(cpt->metaData());
+            delete vs;
+            delete cpt; //be sure to erase all stuff
+        }
     }
+    m_db->endBulkInsert();
     //TODO: not the prettiest way to do it
     //reload the vsoil
-    m_vsoils.clear();
-    m_db->getAllVSoils(m_vsoils);
+    loadVSoilEntities();
+    updateVSoilRegistry();
+    invalidateSpatialIndex();
+    return result;
 }
 
 bool DataStore::importVSoilFromTextFile(QString fileName, QStringList &log)
@@ -188,6 +612,7 @@ bool DataStore::importVSoilFromTextFile(QString fileName, QStringList &log)
         return false;
     }
 
+    m_db->beginBulkInsert();
     QTextStream in(&file);
     QString line = file.readLine();
     while(!in.atEnd()) {
@@ -229,102 +654,576 @@ bool DataStore::importVSoilFromTextFile(QString fileName, QStringList &log)
             if(err.isValid()){
                 qDebug() << "DBERROR:" << err;
                 log.append(QString("SKIPPED file %1 because of database error %2").arg(fileName).arg(err.text()));
+                m_db->endBulkInsert(); //keep the vsoils that were added before the error
                 return false;
             }
         }
         if(in.atEnd()) break;
     }
+    m_db->endBulkInsert();
     file.close();
     //reload all vsoils
-    m_vsoils.clear();
-    m_db->getAllVSoils(m_vsoils);
+    loadVSoilEntities();
+    updateVSoilRegistry();
+    invalidateSpatialIndex();
+    return true;
+}
+
+/*
+  Loads the cpt with the given id including its measurements. These are read
+  from the database, or from the original GEF file if the database does not
+  have them or if they are damaged. Returns false if the cpt could not be
+  loaded.
+  */
+bool DataStore::loadCPT(const int id, CPT &cpt, QStringList &log)
+{
+    int index = -1;
+    for(int i=0; i<m_cptsMetaData.count(); i++){
+        if(m_cptsMetaData.at(i).id == id){
+            index = i;
+            break;
+        }
+    }
+    if(index == -1){
+        log.append(QString("ERROR no cpt found with id %1").arg(id));
+        return false;
+    }
+    const sCPTMetaData &md = m_cptsMetaData.at(index);
+    cpt.setMetaData(md);
+
+    QByteArray data;
+    QSqlError err;
+    if(m_db->getCPTData(id, data, err)){
+        if(cpt.blobToData(data))
+            return true;
+        log.append(QString("The stored data of cpt %1 is damaged, reading the file %2 instead.").arg(id).arg(md.fileName));
+    }else if(err.isValid()){
+        qDebug() << "DBERROR:" << err;
+    }
+
+    //older database or damaged data, fall back to the GEF file
+    if(!cpt.readFromFile(md.fileName, log))
+        return false;
+    cpt.setId(id);
+    return true;
+}
+
+/*
+  Reads the GEF files of all cpts that do not have their measurements in
+  the database yet and stores them, so they can be loaded without the files
+  */
+bool DataStore::storeMissingCPTData(QStringList &log)
+{
+    log.append("LOGBOOK store cpt data");
+    QSet<int> ids;
+    m_db->getCPTIdsWithData(ids);
+    bool result = true;
+    QSqlError err;
+    m_db->beginBulkInsert();
+    for(int i=0; i<m_cptsMetaData.count(); i++){
+        const sCPTMetaData &md = m_cptsMetaData.at(i);
+        if(md.id < 0 || ids.contains(md.id))
+            continue;
+        CPT cpt;
+        if(!cpt.readFromFile(md.fileName, log)){
+            log.append(QString("SKIPPED cpt %1 because the file %2 could not be read.").arg(md.id).arg(md.fileName));
+            result = false;
+            continue;
+        }
+        m_db->setCPTData(md.id, cpt.dataAsQByteArray(), err);
+        if(err.isValid()){
+            qDebug() << "DBERROR:" << err;
+            log.append(QString("SKIPPED cpt %1 because of database error %2").arg(md.id).arg(err.text()));
+            result = false;
+        }
+    }
+    m_db->endBulkInsert();
+    return result;
+}
+
+/*
+  One cpt derived vsoil to regenerate, see regenerateCPTVSoils
+  */
+struct sVSoilRegeneration{
+    sCPTMetaData metaData;
+    QByteArray cptData; //empty if the measurements are not in the database
+    VSoil *vsoil;       //only used on the calling thread
+    QByteArray layers;  //the new layers (VSoil::dataAsQByteArray)
+    bool ok;
+    QStringList log;
+};
+
+/*
+  Functor for QtConcurrent::map, rebuilds the layers of one vsoil from the
+  stored cpt (or the GEF file) without touching the database or the vsoil
+  */
+struct sVSoilRegenerator{
+    QSharedPointer<const SoilClassifier> classifier;
+    bool segmented;
+    sSegmentation segmentation;
+    double minInterval;
+
+    void operator()(sVSoilRegeneration &item) const
+    {
+        CPT cpt;
+        cpt.setMetaData(item.metaData);
+        item.ok = false;
+        if(!item.cptData.isEmpty()){
+            item.ok = cpt.blobToData(item.cptData);
+            if(!item.ok)
+                item.log.append(QString("The stored data of cpt %1 is damaged, reading the file %2 instead.").arg(item.metaData.id).arg(item.metaData.fileName));
+        }
+        if(!item.ok)
+            item.ok = cpt.readFromFile(item.metaData.fileName, item.log);
+        item.cptData.clear();
+        if(!item.ok)
+            return;
+        VSoil vsoil;
+        if(segmented)
+            cpt.generateVSoilBySegments(vsoil, segmentation, classifier.data());
+        else
+            cpt.generateVSoil(vsoil, minInterval, classifier.data());
+        item.layers = vsoil.dataAsQByteArray();
+    }
+};
+
+/*
+  Returns true if the blob holds the same layers as the vsoil
+  */
+static bool sameLayers(const QByteArray &blob, VSoil *vs)
+{
+    VSoilLayerList layers;
+    if(!VSoil::blobToLayers(blob, layers) || layers.count() != vs->getSoilLayers()->count())
+        return false;
+    for(int i=0; i<layers.count(); i++){
+        const VSoilLayer &a = layers.at(i);
+        const VSoilLayer &b = vs->getSoilLayers()->at(i);
+        if(a.zmax != b.zmax || a.zmin != b.zmin || a.soiltype_id != b.soiltype_id)
+            return false;
+    }
     return true;
 }
 
-void DataStore::generateGeoProfile2D(QList<QPointF> &latlonPoints)
-{
-    GeoProfile2D *geo = new GeoProfile2D();
-    geo->setZMax(-9999.); //used to store the min z value in profile
-    geo->setZMin(9999.); //used to store the max z value in profile
-    //initialization
-    int id = -1;
-    double currentLength = 0.;
-    double prevLength = 0.;    
-
-    //add the lines to the geoprofile so we always know from which line it was generated
-    for(int i=0; i<latlonPoints.count(); i++)
-        geo->points()->append(latlonPoints.at(i));
-
-    //wander through all lines
-    for(int i=0; i<latlonPoints.count()-1; i++){
-        //get the start- and endpoint both as latlon and rdcoords
-        LatLon p1 = LatLon(latlonPoints.at(i));
-        QPointF p1rd = p1.asRDCoords();        
-        LatLon p2 = LatLon(latlonPoints.at(i+1));
-        QPointF p2rd = p2.asRDCoords();
-        //how long is this line..
-        int dL = int(sqrt((p2rd.x() - p1rd.x()) * (p2rd.x() - p1rd.x()) + ((p2rd.y() - p1rd.y()) * (p2rd.y() - p1rd.y()))));
-        //richtingsvector.. in english?
-        QPointF rv((p2rd.x() - p1rd.x()), (p2rd.y() - p1rd.y()));
-        //walk across the line in 1m steps
-
-        for(int j=0; j<=dL; j++){
-            //step one meter along the line
-            int x = int(p1rd.x() + j * rv.x() / dL);
-            int y = int(p1rd.y() + j * rv.y() / dL);
-            //find the closest vsoilid based on the current coord
-            int cId = getVSoilIdClosestTo(QPointF(x,y));
-            //TODO: what if cId == -1?
-            if(cId > -1){ //check the limits
-                VSoil *vs = getVSoilById(cId);
-                if(geo->zMax() < vs->zMax())
-                    geo->setZMax(vs->zMax());
-                if(geo->zMin() > vs->zMin())
-                    geo->setZMin(vs->zMin());
-                geo->addSoilTypeIDs(vs);
+/*
+  Regenerates the layers of all vsoils that were generated from a cpt with
+  the current chart and segmentation settings (see setSoilClassifier and
+  setCPTSegmentation), minInterval is used without segmentation.
+  A vsoil is regenerated if its source is still "CPT conversion", it has no
+  unsaved changes and its layers are still the layers that were generated
+  for it (stored in the vsoil_generated table by importCPTS and by this
+  function). Vsoils without generated layers were imported before they were
+  stored, they could have been edited so they are only regenerated if
+  includeUnmarked is set. The cpts are handled in batches; the measurements
+  are read on the calling thread, the layers are generated on the thread
+  pool and written back in bulk transactions.
+  */
+bool DataStore::regenerateCPTVSoils(QStringList &log, double minInterval, bool includeUnmarked)
+{
+    log.append("LOGBOOK regenerate cpt vsoils");
+    if(!m_dataLoaded){
+        log.append("Trying to regenerate vsoils with closed database.");
+        return false;
+    }
+
+    //find the vsoil of every cpt, older databases have no link so use the location
+    QHash<QPair<double, double>, VSoil*> vsoilsByLocation;
+    for(int i=m_vsoils.count()-1; i>=0; i--)
+        vsoilsByLocation.insert(qMakePair(m_vsoils.at(i)->x(), m_vsoils.at(i)->y()), m_vsoils.at(i));
+    QSet<int> cptIdsWithData;
+    m_db->getCPTIdsWithData(cptIdsWithData);
+    QHash<int, QByteArray> generatedLayers;
+    m_db->getGeneratedVSoilData(generatedLayers);
+
+    QList<sVSoilRegeneration> items;
+    QSet<VSoil*> seen;
+    int numSkipped = 0;
+    int numUnmarked = 0;
+    for(int i=0; i<m_cptsMetaData.count(); i++){
+        const sCPTMetaData &md = m_cptsMetaData.at(i);
+        VSoil *vs = m_vsoilsById.value(md.vsoilId, NULL);
+        if(vs == NULL || vs->x() != md.x || vs->y() != md.y)
+            vs = vsoilsByLocation.value(qMakePair(md.x, md.y), NULL);
+        if(vs == NULL || seen.contains(vs))
+            continue;
+        if(vs->source() != "CPT conversion" || vs->dataChanged()){
+            numSkipped++;
+            continue;
+        }
+        if(!generatedLayers.contains(vs->id())){
+            if(!includeUnmarked){
+                numUnmarked++;
+                continue;
             }
-            if(j==0){ //first point, just set the id to the current id
-                id = cId; //set the id to the newly found id
-                prevLength = 0.; //set the previous length to zero
+        }else if(!sameLayers(generatedLayers.value(vs->id()), vs)){
+            numSkipped++;
+            continue;
+        }
+        seen.insert(vs);
+        sVSoilRegeneration item;
+        item.metaData = md;
+        item.vsoil = vs;
+        item.ok = false;
+        items.append(item);
+    }
+
+    sVSoilRegenerator regenerator;
+    regenerator.classifier = m_soilClassifier;
+    regenerator.segmented = m_segmentCPTs;
+    regenerator.segmentation = m_segmentation;
+    regenerator.minInterval = minInterval;
+
+    bool result = true;
+    int numRegenerated = 0;
+    QSqlError err;
+    m_db->beginBulkInsert();
+    for(int start=0; start<items.count(); start+=m_importBatchSize){
+        QList<sVSoilRegeneration> batch = items.mid(start, m_importBatchSize);
+        for(int j=0; j<batch.count(); j++){
+            if(cptIdsWithData.contains(batch[j].metaData.id) && !m_db->getCPTData(batch[j].metaData.id, batch[j].cptData, err))
+                qDebug() << "DBERROR:" << err;
+        }
+        QtConcurrent::blockingMap(batch, regenerator);
+
+        for(int j=0; j<batch.count(); j++){
+            log.append(batch[j].log);
+            VSoil *vs = batch[j].vsoil;
+            if(!batch[j].ok){
+                log.append(QString("SKIPPED vsoil %1 because cpt %2 could not be read.").arg(vs->id()).arg(batch[j].metaData.id));
+                result = false;
+                continue;
             }
-            else if((j==dL)||(id!=cId)){ //last point or new id, add the line
-                sArea l; //create new line
-                l.start = currentLength + prevLength; //it started where the latter ended
-                l.end = currentLength + j; //and now it is a the current length
-                l.vsoilId = id; //with this new id
-                geo->areas()->append(l); //add it to the result
-                id = cId; //set the id to the new id
-                prevLength = j; //and make sure the prev length equals the current length
-                if(j==dL) { currentLength += j; } //keep the current length for the next line
+            m_db->updateVSoilData(vs->id(), batch[j].layers, err);
+            if(err.isValid()){
+                qDebug() << "DBERROR:" << err;
+                log.append(QString("SKIPPED vsoil %1 because of database error %2").arg(vs->id()).arg(err.text()));
+                result = false;
+                continue;
             }
+            m_db->setGeneratedVSoilData(vs->id(), batch[j].layers, err);
+            if(err.isValid())
+                qDebug() << "DBERROR:" << err;
+            vs->blobToData(batch[j].layers);
+            numRegenerated++;
         }
+    }
+    m_db->endBulkInsert();
+
+    log.append(QString("Regenerated %1 vsoils, %2 edited vsoils were left untouched.").arg(numRegenerated).arg(numSkipped));
+    if(numUnmarked > 0)
+        log.append(QString("%1 vsoils were imported before their generated layers were stored and were left untouched, they may have been edited.").arg(numUnmarked));
+    invalidateSpatialIndex();
+    invalidateLayerProperties();
+    return result;
+}
 
+/*
+  Converts the vsoil layer data in the database from the old text layout to
+  the binary layout, the vsoils in memory are not affected
+  */
+bool DataStore::convertVSoilData(QStringList &log)
+{
+    log.append("LOGBOOK convert vsoil data");
+    int converted = 0;
+    QSqlError err;
+    if(!m_db->convertVSoilBlobs(converted, err)){
+        qDebug() << "DBERROR:" << err;
+        log.append(QString("ERROR converting the vsoil data, nothing is changed: %1").arg(err.text()));
+        return false;
     }
-    geo->optimize();
+    log.append(QString("Converted the data of %1 vsoils.").arg(converted));
+    return true;
+}
+
+void DataStore::generateGeoProfile2D(QList<QPointF> &latlonPoints, GeoProfileMethod method)
+{
+    updateVSoilSnapshot();
+    ProjectedPolyline polyline = ProjectedPolyline::fromLatLon(latlonPoints);
+    GeoProfile2D *geo;
+    if(method == VoronoiProfile)
+        geo = m_vsoilSnapshot->voronoiProfile(polyline);
+    else
+        geo = m_vsoilSnapshot->sampledProfile(polyline);
+    updateProfileLimits(geo);
     m_geoProfile2Ds.append(geo);
 }
 
+/*
+  Same as generateGeoProfile2D for a polyline in RD coordinates, the profile
+  still stores the points as latitude / longitude for the exports
+  */
+void DataStore::generateGeoProfile2DFromRD(const QList<QPointF> &rdPoints, GeoProfileMethod method)
+{
+    updateVSoilSnapshot();
+    ProjectedPolyline polyline = ProjectedPolyline::fromRD(rdPoints);
+    GeoProfile2D *geo;
+    if(method == VoronoiProfile)
+        geo = m_vsoilSnapshot->voronoiProfile(polyline);
+    else
+        geo = m_vsoilSnapshot->sampledProfile(polyline);
+    updateProfileLimits(geo);
+    m_geoProfile2Ds.append(geo);
+}
+
+/*
+  Functor for QtConcurrent::mapped, generates one profile from a shared
+  snapshot and hands the result over to the thread of the datastore
+  */
+struct sProfileGenerator{
+    typedef GeoProfile2D *result_type;
+
+    QSharedPointer<const VSoilSnapshot> snapshot;
+    DataStore::GeoProfileMethod method;
+    QThread *targetThread;
+    bool rdPoints; //the polylines are in rd coordinates instead of latitude / longitude
+
+    GeoProfile2D *operator()(const QList<QPointF> &points) const
+    {
+        ProjectedPolyline polyline = rdPoints ? ProjectedPolyline::fromRD(points) : ProjectedPolyline::fromLatLon(points);
+        GeoProfile2D *geo;
+        if(method == DataStore::VoronoiProfile)
+            geo = snapshot->voronoiProfile(polyline);
+        else
+            geo = snapshot->sampledProfile(polyline);
+        geo->moveToThread(targetThread);
+        return geo;
+    }
+};
+
+/*
+  Generates a profile for every polyline on the thread pool. All profiles are
+  generated from the same snapshot of the enabled vsoils so changes to the
+  vsoils during the batch do not affect it.
+  The results of the future are in the order of polylines. Use a
+  QFutureWatcher for the progress and QFuture::cancel() to stop the batch.
+  The profiles are not added to the datastore, the caller owns them and
+  can pass them to addGeoProfiles2D (also the ones already generated when
+  the batch was canceled).
+  */
+QFuture<GeoProfile2D*> DataStore::generateGeoProfiles2D(const QList<QList<QPointF> > &polylines, GeoProfileMethod method)
+{
+    updateVSoilSnapshot();
+    sProfileGenerator generator;
+    generator.snapshot = m_vsoilSnapshot;
+    generator.method = method;
+    generator.targetThread = thread();
+    generator.rdPoints = false;
+    return QtConcurrent::mapped(polylines, generator);
+}
+
+/*
+  Same as generateGeoProfiles2D for polylines in RD coordinates
+  */
+QFuture<GeoProfile2D*> DataStore::generateGeoProfiles2DFromRD(const QList<QList<QPointF> > &rdPolylines, GeoProfileMethod method)
+{
+    updateVSoilSnapshot();
+    sProfileGenerator generator;
+    generator.snapshot = m_vsoilSnapshot;
+    generator.method = method;
+    generator.targetThread = thread();
+    generator.rdPoints = true;
+    return QtConcurrent::mapped(rdPolylines, generator);
+}
+
+/*
+  Deletes all generated profiles
+  */
+void DataStore::clearGeoProfiles2D()
+{
+    qDeleteAll(m_geoProfile2Ds);
+    m_geoProfile2Ds.clear();
+}
+
+void DataStore::addGeoProfiles2D(const QList<GeoProfile2D *> &profiles)
+{
+    for(int i=0; i<profiles.count(); i++)
+        updateProfileLimits(profiles[i]);
+    m_geoProfile2Ds.append(profiles);
+}
+
+/*
+  Sets the depth limits and soiltypes of a profile from the current layers
+  of its vsoils. The snapshot copies them when it is built and the layers
+  can be edited through getSoilLayers() after that without invalidating it,
+  the areas only depend on the locations so they stay valid.
+  */
+void DataStore::updateProfileLimits(GeoProfile2D *geo)
+{
+    QList<int> vsoilIds;
+    geo->getUniqueVSoilsIDs(vsoilIds);
+    geo->setZMax(-9999.);
+    geo->setZMin(9999.);
+    geo->soilTypeIDs()->clear();
+    for(int i=0; i<vsoilIds.count(); i++){
+        VSoil *vs = getVSoilById(vsoilIds.at(i));
+        if(vs==NULL)
+            continue;
+        if(geo->zMax() < vs->zMax())
+            geo->setZMax(vs->zMax());
+        if(geo->zMin() > vs->zMin())
+            geo->setZMin(vs->zMin());
+        geo->addSoilTypeIDs(vs);
+    }
+}
+
+/*
+  Functor for QtConcurrent, scores one vsoil. The running sums of c and phi
+  have to be built before (see prepareWeakSpotScores), the threads only read
+  them.
+  */
+struct sWeakSpotScorer{
+    typedef sWeakSpot result_type;
+
+    DataStore *store;
+    int depth;
+
+    sWeakSpot operator()(VSoil *vs) const
+    {
+        sWeakSpot ws;
+        ws.vsoilId = vs->id();
+        ws.latitude = vs->latitude();
+        ws.longitude = vs->longitude();
+        ws.avgC = store->getAverage(vs, SoilType::C, vs->zMax(), vs->zMax() - depth);
+        ws.avgPhi = store->getAverage(vs, SoilType::Phi, vs->zMax(), vs->zMax() - depth);
+        ws.score = ws.avgC / 10.0 + ws.avgPhi / 35.0;
+        return ws;
+    }
+};
+
+/*
+  Builds the running sums that sWeakSpotScorer uses on the calling thread,
+  two threads could otherwise build those of the same vsoil at once
+  */
+void DataStore::prepareWeakSpotScores(const QList<VSoil*> &vsoils)
+{
+    for(int i=0; i<vsoils.count(); i++){
+        updateLayerIntegral(vsoils[i], SoilType::C);
+        updateLayerIntegral(vsoils[i], SoilType::Phi);
+    }
+}
+
+static bool weakSpotLessThan(const sWeakSpot &a, const sWeakSpot &b)
+{
+    if(a.score != b.score)
+        return a.score < b.score;
+    return a.vsoilId < b.vsoilId;
+}
+
 /*
   scans the first <depth> meters and returns the id of the vsoil with the
   smallest c and phi within the visible area
 */
 void DataStore::findWeakestSpot(const QRectF boundary, const int depth)
 {
-    int id = -1;
-    double worstScore = 9999.0;
+    QList<sWeakSpot> spots = findWeakestSpots(boundary, depth, 1);
+    if(spots.count() > 0)
+        qDebug() << "UITSLAG: " << spots[0].score << " met id " << spots[0].vsoilId;
+    else
+        qDebug() << "UITSLAG: " << 9999.0 << " met id " << -1;
+}
+
+/*
+  Scores the first <depth> meters of all enabled vsoils within the boundary
+  on the threadpool and returns the k weakest ones, weakest first
+  */
+QList<sWeakSpot> DataStore::findWeakestSpots(const QRectF boundary, const int depth, const int k)
+{
+    QList<VSoil*> vsoils;
     foreach(VSoil *vs, getVisibleVSoils(boundary)){
-        if(vs->isEnabled()){
-            double avgc = getAverageC(vs->id(), depth);
-            double avgphi = getAveragePhi(vs->id(), depth);
-            double score = avgc / 10.0 + avgphi / 35.0;
-            qDebug() << vs->id() << avgc << avgphi << score;
-            if (score < worstScore){
-                id = vs->id();
-                worstScore = score;
-            }
+        if(vs->isEnabled())
+            vsoils.append(vs);
+    }
+    prepareWeakSpotScores(vsoils);
+    sWeakSpotScorer scorer;
+    scorer.store = this;
+    scorer.depth = depth;
+    QList<sWeakSpot> spots = QtConcurrent::blockingMapped<QList<sWeakSpot> >(vsoils, scorer);
+
+    int n = qBound(0, k, spots.count());
+    std::partial_sort(spots.begin(), spots.begin() + n, spots.end(), weakSpotLessThan);
+    return spots.mid(0, n);
+}
+
+/*
+  Functor for QtConcurrent, finds the closest vsoil for every cell of one
+  row of the raster
+  */
+struct sRasterRowOwners{
+    QSharedPointer<const VSoilSnapshot> snapshot;
+    const sScoreRaster *raster;
+    int *owners; //columns * rows snapshot indexes
+
+    void operator()(const int &row) const
+    {
+        double dLon = (raster->right - raster->left) / raster->columns;
+        double dLat = (raster->top - raster->bottom) / raster->rows;
+        double lat = raster->top - (row + 0.5) * dLat;
+        QVector<QPointF> cells(raster->columns);
+        for(int c=0; c<raster->columns; c++)
+            cells[c] = QPointF(raster->left + (c + 0.5) * dLon, lat);
+        LatLon::toRD(cells.constData(), cells.data(), cells.count()); //in place
+        for(int c=0; c<raster->columns; c++)
+            owners[row * raster->columns + c] = snapshot->nearest(cells.at(c));
+    }
+};
+
+/*
+  Fills a raster of columns x rows cells over the boundary (lon = x, lat = y,
+  top >= bottom) with the score of the first <depth> meters of the closest
+  enabled vsoil to the center of every cell. Every vsoil is scored once.
+  */
+bool DataStore::getScoreRaster(const QRectF boundary, const int depth, const int columns, const int rows, sScoreRaster &raster)
+{
+    if(columns <= 0 || rows <= 0){
+        qDebug() << "Error in DataStore::getScoreRaster; invalid raster size" << columns << rows;
+        return false;
+    }
+    raster.left = boundary.left();
+    raster.bottom = boundary.bottom();
+    raster.right = boundary.right();
+    raster.top = boundary.top();
+    raster.columns = columns;
+    raster.rows = rows;
+    raster.scores.fill(-9999., columns * rows);
+
+    updateVSoilSnapshot();
+    QVector<int> owners(columns * rows);
+    QList<int> rowNumbers;
+    for(int r=0; r<rows; r++)
+        rowNumbers.append(r);
+    sRasterRowOwners rowOwners;
+    rowOwners.snapshot = m_vsoilSnapshot;
+    rowOwners.raster = &raster;
+    rowOwners.owners = owners.data();
+    QtConcurrent::blockingMap(rowNumbers, rowOwners);
+
+    //score every vsoil that owns at least one cell
+    QList<VSoil*> vsoils;
+    QHash<int, int> scoreIndexes; //vsoil id -> index in vsoils
+    for(int i=0; i<owners.count(); i++){
+        if(owners[i] == -1)
+            continue;
+        int id = m_vsoilSnapshot->at(owners[i]).id;
+        if(!scoreIndexes.contains(id)){
+            VSoil *vs = getVSoilById(id);
+            scoreIndexes.insert(id, (vs == NULL) ? -1 : vsoils.count());
+            if(vs != NULL)
+                vsoils.append(vs);
         }
     }
-    qDebug() << "UITSLAG: " << worstScore << " met id " << id;
+    prepareWeakSpotScores(vsoils);
+    sWeakSpotScorer scorer;
+    scorer.store = this;
+    scorer.depth = depth;
+    QList<sWeakSpot> spots = QtConcurrent::blockingMapped<QList<sWeakSpot> >(vsoils, scorer);
+
+    for(int i=0; i<owners.count(); i++){
+        if(owners[i] == -1)
+            continue;
+        int index = scoreIndexes.value(m_vsoilSnapshot->at(owners[i]).id);
+        if(index > -1)
+            raster.scores[i] = spots[index].score;
+    }
+    return true;
 }
 
 bool DataStore::exportGeoProfileToQGeoFile(const QString fileName, const int geoProfileIndex)
@@ -333,10 +1232,9 @@ bool DataStore::exportGeoProfileToQGeoFile(const QString fileName, const int geo
     QFile file(fileName);
 
     if (!file.open(QFile::WriteOnly | QFile::Text)) {
-             QMessageBox::warning(NULL, tr("Datastore"),
-                                  tr("Cannot write file %1:\n%2.").arg(fileName).arg(file.errorString()));
-             return false;
-         }
+        emit error(tr("Cannot write file %1:\n%2.").arg(fileName).arg(file.errorString()));
+        return false;
+    }
 
     //write the xml
     QXmlStreamWriter xml(&file);
@@ -396,22 +1294,22 @@ bool DataStore::exportGeoProfileToQGeoFile(const QString fileName, const int geo
 
             //topleft point
             xml.writeStartElement("Point");
-            xml.writeAttribute("x", QString("%1").arg(area.start));
+            xml.writeAttribute("x", QString("%1").arg(area.start, 0, 'g', 10));
             xml.writeAttribute("y", QString("%1").arg(topLayer.zmax, 0, 'f', 1));
             xml.writeEndElement();
             //topright point
             xml.writeStartElement("Point");
-            xml.writeAttribute("x", QString("%1").arg(area.end));
+            xml.writeAttribute("x", QString("%1").arg(area.end, 0, 'g', 10));
             xml.writeAttribute("y", QString("%1").arg(topLayer.zmax, 0, 'f', 1));
             xml.writeEndElement();
             //bottomright point
             xml.writeStartElement("Point");
-            xml.writeAttribute("x", QString("%1").arg(area.end));
+            xml.writeAttribute("x", QString("%1").arg(area.end, 0, 'g', 10));
             xml.writeAttribute("y", QString("%1").arg(topLayer.zmin, 0, 'f', 1));
             xml.writeEndElement();
             //bottomleft point
             xml.writeStartElement("Point");
-            xml.writeAttribute("x", QString("%1").arg(area.start));
+            xml.writeAttribute("x", QString("%1").arg(area.start, 0, 'g', 10));
             xml.writeAttribute("y", QString("%1").arg(topLayer.zmin, 0, 'f', 1));
             xml.writeEndElement();
 
@@ -427,8 +1325,7 @@ bool DataStore::exportGeoProfileToQGeoFile(const QString fileName, const int geo
     //close and check for errors
     file.close();
     if(file.error()){
-        QMessageBox::warning(NULL, tr("Datastore"),
-                             tr("Cannot write file %1:\n%2.").arg(fileName).arg(file.errorString()));
+        emit error(tr("Cannot write file %1:\n%2.").arg(fileName).arg(file.errorString()));
         return false;
     }
     return true;
@@ -508,8 +1405,8 @@ bool DataStore::exportGeoProfileToDAM(QString path, const int geoProfileIndex)
     out << "van,tot,segment_id\n";
     //write the segment information
     for(int i=0; i<geo->areas()->count();i++){
-        out << QString("%1,%2,%3\n").arg(geo->areas()->at(i).start)
-               .arg(geo->areas()->at(i).end)
+        out << QString("%1,%2,%3\n").arg(geo->areas()->at(i).start, 0, 'g', 10)
+               .arg(geo->areas()->at(i).end, 0, 'g', 10)
                .arg(geo->areas()->at(i).vsoilId);
 
     }
@@ -584,12 +1481,9 @@ bool DataStore::exportGeoProfileToKMLfile(const QString fileName, const int geoP
     QFile file(fileName);
 
     if (!file.open(QFile::WriteOnly | QFile::Text)) {
-             QMessageBox::warning(NULL, tr("Datastore"),
-                                  tr("Cannot write file %1:\n%2.")
-                                  .arg(fileName)
-                                  .arg(file.errorString()));
-             return false;
-         }
+        emit error(tr("Cannot write file %1:\n%2.").arg(fileName).arg(file.errorString()));
+        return false;
+    }
 
     QTextStream out(&file);
 
@@ -1157,54 +2051,136 @@ bool DataStore::exportGeoProfileToSTIfile(const QString fileName, const int geoP
     //TODO: add done message!
 }
 
-VSoil *DataStore::getVSoilById(int id)
+/*
+  Rebuilds the id -> vsoil lookup, call this after m_vsoils is (re)loaded.
+  If an id is used more than once the first vsoil in the list is used.
+  */
+void DataStore::updateVSoilRegistry()
 {
-    for(int i=0; i<m_vsoils.count(); i++){
-        if(m_vsoils.at(i)->id()==id)
-            return m_vsoils.at(i);
+    m_vsoilsById.clear();
+    m_vsoilsById.reserve(m_vsoils.count());
+    for(int i=m_vsoils.count()-1; i>=0; i--)
+        m_vsoilsById.insert(m_vsoils.at(i)->id(), m_vsoils.at(i));
+}
+
+/*
+  Rebuilds the id -> soiltype lookup, call this after m_soilTypes is (re)loaded
+  */
+void DataStore::updateSoilTypeRegistry()
+{
+    m_soilTypesById.clear();
+    m_soilTypesById.reserve(m_soilTypes.count());
+    for(int i=m_soilTypes.count()-1; i>=0; i--){
+        m_soilTypesById.insert(m_soilTypes.at(i)->id(), m_soilTypes.at(i));
+        //edits of the soiltypes change the averages of the vsoils
+        connect(m_soilTypes.at(i), SIGNAL(parametersChanged()), this, SLOT(invalidateLayerProperties()), Qt::UniqueConnection);
     }
-    return NULL; //TODO: Check boundaties and give meaningfull error if it's out of bounds
+
+    //map the classes of the chart on the (new) soiltypes
+    m_soilClassifierLog.clear();
+    m_soilClassifier->mapToSoilTypes(m_soilTypes, m_soilClassifierLog);
+}
+
+/*
+  Selects how importCPTS generates the vsoils, by change points with the
+  given settings (enabled) or every 0.1m followed by VSoil::optimize
+  */
+void DataStore::setCPTSegmentation(bool enabled, const sSegmentation &settings)
+{
+    m_segmentCPTs = enabled;
+    m_segmentation = settings;
+}
+
+/*
+  Sets the chart that is used to generate vsoils from cpts. If the chart
+  maps its classes on the soiltypes by name (see SoilClassifier) the
+  unmapped classes are reported in the log, also see soilClassifierLog.
+  */
+void DataStore::setSoilClassifier(QSharedPointer<SoilClassifier> classifier, QStringList &log)
+{
+    if(classifier.isNull())
+        return;
+    m_soilClassifierLog.clear();
+    classifier->mapToSoilTypes(m_soilTypes, m_soilClassifierLog);
+    log.append(m_soilClassifierLog);
+    m_soilClassifier = classifier;
+}
+
+VSoil *DataStore::getVSoilById(int id)
+{
+    return m_vsoilsById.value(id, NULL); //TODO: Check boundaties and give meaningfull error if it's out of bounds
 }
 
 SoilType *DataStore::getSoilTypeById(int id)
 {
-    for(int i=0; i<m_soilTypes.count(); i++){
-        if(m_soilTypes.at(i)->id()==id)
-            return m_soilTypes.at(i);
-    }
-    return NULL; //TODO: Check boundaties and give meaningfull error if it's out of bounds
+    return m_soilTypesById.value(id, NULL); //TODO: Check boundaties and give meaningfull error if it's out of bounds
 }
 
-double DataStore::getAveragePhi(const int vsoilId, const int depth){
+/*
+  Returns the thickness weighted average of a soiltype parameter of the vsoil
+  between zTop and zBottom (zTop > zBottom). Parts of the range outside of the
+  soil layers count as 0. The running sums per vsoil are (re)built on first use
+  and after a change of the soiltypes or the layers, otherwise a call only
+  needs two binary searches.
+  */
+double DataStore::getAverage(const int vsoilId, SoilType::Parameter parameter, double zTop, double zBottom)
+{
     VSoil *vs = getVSoilById(vsoilId);
     if(vs==NULL){
-        qDebug() << "Error in DataStore::getAveragePhi; no VSoil found with id = " << vsoilId;
+        qDebug() << "Error in DataStore::getAverage; no VSoil found with id = " << vsoilId;
+        return 0.0;
+    }
+    return getAverage(vs, parameter, zTop, zBottom);
+}
+
+//same as above for a vsoil of the datastore, also one that shares its id with another one
+double DataStore::getAverage(VSoil *vs, SoilType::Parameter parameter, double zTop, double zBottom)
+{
+    if(vs->zMax() - vs->zMin() <= 0.00){
+        qDebug() << "Error in DataStore::getAverage; vsoil of 0 length, vsoilId = " << vs->id();
+        return 0.0;
+    }
+    if(zTop <= zBottom){
+        qDebug() << "Error in DataStore::getAverage; invalid range" << zTop << zBottom << "for vsoilId = " << vs->id();
         return 0.0;
     }
-    double sum = 0.0;
-    double maxDepth = vs->zMax() - depth;
+    if(!updateLayerIntegral(vs, parameter))
+        return 0.0;
+    return vs->integrateLayers(parameter, zTop, zBottom) / (zTop - zBottom);
+}
 
+/*
+  Builds the running sums of the parameter for the vsoil if they are missing
+  or outdated. Returns false if a soiltype of the layers is unknown.
+  */
+bool DataStore::updateLayerIntegral(VSoil *vs, SoilType::Parameter parameter)
+{
+    if(vs->hasLayerIntegral(parameter, m_layerPropertiesRevision))
+        return true;
+    QVector<double> values(vs->getSoilLayers()->count());
     for(int i=0; i<vs->getSoilLayers()->count(); i++){
         SoilType *st = getSoilTypeById(vs->getSoilLayers()->at(i).soiltype_id);
         if(st==NULL){
-            qDebug() << "Error in DataStore::getAveragePhi; no SoilType found with id = " << vs->getSoilLayers()->at(i).soiltype_id;
-            return 0.0;
-        }
-
-        if(vs->getSoilLayers()->at(i).zmin < maxDepth){
-            sum += (vs->getSoilLayers()->at(i).zmax - maxDepth) * st->phi();
-            break;
+            qDebug() << "Error in DataStore::getAverage; no SoilType found with id = " << vs->getSoilLayers()->at(i).soiltype_id;
+            return false;
         }
-        sum += (vs->getSoilLayers()->at(i).zmax - vs->getSoilLayers()->at(i).zmin) * st->phi();
+        values[i] = st->parameter(parameter);
     }
-    if(vs->zMax() - vs->zMin() <= 0.00){
-        qDebug() << "Error in DataStore::getAveragePhi; vsoil of 0 length, vsoilId = " << vsoilId;
+    vs->setLayerIntegral(parameter, m_layerPropertiesRevision, values);
+    return true;
+}
+
+//average phi over the first depth meters of the vsoil
+double DataStore::getAveragePhi(const int vsoilId, const int depth){
+    VSoil *vs = getVSoilById(vsoilId);
+    if(vs==NULL){
+        qDebug() << "Error in DataStore::getAveragePhi; no VSoil found with id = " << vsoilId;
         return 0.0;
     }
-
-    return sum / double(depth);
+    return getAverage(vsoilId, SoilType::Phi, vs->zMax(), vs->zMax() - depth);
 }
 
+//average c over the first depth meters of the vsoil
 double DataStore::getAverageC(const int vsoilId, const int depth)
 {
     VSoil *vs = getVSoilById(vsoilId);
@@ -1212,59 +2188,35 @@ double DataStore::getAverageC(const int vsoilId, const int depth)
         qDebug() << "Error in DataStore::getAverageC; no VSoil found with id = " << vsoilId;
         return 0.0;
     }
-    double sum = 0.0;
-    double maxDepth = vs->zMax() - depth;
-
-    for(int i=0; i<vs->getSoilLayers()->count(); i++){
-        SoilType *st = getSoilTypeById(vs->getSoilLayers()->at(i).soiltype_id);
-        if(st==NULL){
-            qDebug() << "Error in DataStore::getAverageC; no SoilType found with id = " << vs->getSoilLayers()->at(i).soiltype_id;
-            return 0.0;
-        }
-
-        if(vs->getSoilLayers()->at(i).zmin < maxDepth){
-            sum += (vs->getSoilLayers()->at(i).zmax - maxDepth) * st->c();
-            break;
-        }
-        sum += (vs->getSoilLayers()->at(i).zmax - vs->getSoilLayers()->at(i).zmin) * st->c();
-    }
-    if(vs->zMax() - vs->zMin() <= 0.00){
-        qDebug() << "Error in DataStore::getAverageC; vsoil of 0 length, vsoilId = " << vsoilId;
-        return 0.0;
-    }
-
-    return sum / double(depth);
+    return getAverage(vsoilId, SoilType::C, vs->zMax(), vs->zMax() - depth);
 }
 
 //returns the next possible vsoilid
 int DataStore::getNextVSoilId()
 {
-    //create a list with all ids
-    QList<int> m_ids;
-    for(int i=0; i<m_vsoils.count(); i++)
-        m_ids.append(m_vsoils[i]->id());
-
     //start from 1 and return as soon as a new unused id is found
     int id = 1;
-    while(1){
-        if(!m_ids.contains(id))
-            return id;
+    while(m_vsoilsById.contains(id))
         id++;
-    }
-
+    return id;
 }
 
 bool DataStore::addNewVSoil(QPointF pointLatLon, QString source)
 {
-    VSoil *vs = new VSoil;
-    vs->setId(getNextVSoilId());
+    int id = getNextVSoilId();
+    sVSoilRecord *record = m_entities.addVSoil(id);
+    VSoil *vs = record ? new VSoil(record) : new VSoil;
+    vs->setId(id);
     vs->setSource(source);
     vs->setLatitude(pointLatLon.x());
     vs->setLongitude(pointLatLon.y());
     LatLon l(pointLatLon);
-    vs->setX(l.asRDCoords().x());
-    vs->setY(l.asRDCoords().y());
+    QPointF rd = l.asRDCoords();
+    vs->setX(rd.x());
+    vs->setY(rd.y());
     m_vsoils.append(vs);
+    m_vsoilsById.insert(vs->id(), vs);
+    invalidateSpatialIndex();
     return true;
 }
 
@@ -1285,6 +2237,8 @@ void DataStore::getVSoilLocations(QStringList &locations)
 void DataStore::saveChanges()
 {
     QSqlError err;
+    //changed vsoils may have been moved
+    invalidateSpatialIndex();
     //check and save vsoils
     for(int i=0; i<m_vsoils.count(); i++){
         if(m_vsoils[i]->dataChanged()){
@@ -1299,6 +2253,7 @@ void DataStore::saveChanges()
 void DataStore::saveSoilTypes()
 {
     QSqlError err;
+    invalidateLayerProperties();
     for(int i=0; i<m_soilTypes.count(); i++){
         if(m_soilTypes[i]->dataChanged()){
             m_db->updateSoilType(m_soilTypes[i], err);
@@ -1311,8 +2266,9 @@ void DataStore::saveSoilTypes()
 
 void DataStore::reloadSoilTypes()
 {
-    m_soilTypes.clear();
-    m_db->getAllSoilTypes(m_soilTypes);
+    loadSoilTypeEntities();
+    updateSoilTypeRegistry();
+    invalidateLayerProperties();
 }
 
 void DataStore::setFilter(int code)
@@ -1321,4 +2277,5 @@ void DataStore::setFilter(int code)
     for(int i=0; i<m_vsoils.count(); i++){
         m_vsoils[i]->setEnabled(m_vsoils[i]->levee_location()==code);
     }
+    invalidateSpatialIndex();
 }
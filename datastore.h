@@ -3,34 +3,95 @@
 
 #include <QObject>
 #include <QRectF>
+#include <QFuture>
+#include <QSharedPointer>
+#include <QHash>
 
 #include "cpt.h"
 #include "dbadapter.h"
+#include "soiltype.h"
 #include "geoprofile2d.h"
+#include "spatialindex.h"
+#include "vsoilsnapshot.h"
+#include "soilclassifier.h"
+#include "datastoreloader.h"
+#include "snapshotfile.h"
+#include "entitystore.h"
 
 #include <QPointF>
 
+struct sWeakSpot{
+    int vsoilId;
+    double latitude;
+    double longitude;
+    double avgC;
+    double avgPhi;
+    double score; //avg c / 10 + avg phi / 35, the lower the weaker
+};
+
+struct sScoreRaster{
+    double left;   //longitude
+    double bottom; //latitude
+    double right;  //longitude
+    double top;    //latitude
+    int columns;
+    int rows;
+    QVector<double> scores; //row by row starting at the top, -9999. if there is no vsoil
+};
+
 class DataStore : public QObject
 {
     Q_OBJECT
 public:
+    enum GeoProfileMethod {
+        SampledProfile, //nearest vsoil every meter, areas start and end on whole meters
+        VoronoiProfile  //exact crossings of the voronoi cells of the vsoils
+    };
+
     explicit DataStore(QObject *parent = 0);
     ~DataStore();
 
-    void loadData(QString filename);
+    bool loadData(QString filename);
     bool loadDataNonUI(QString fileName);
-    QList<sCPTMetaData> getVisibleCPTs(QRectF boundary);
-    QList<VSoil *> getVisibleVSoils(QRectF boundary);
+    bool loadDataAsync(QString fileName);
+    void cancelLoad();
+    bool isLoading() { return m_loader != NULL; }
+    bool loadDataFromSnapshot(QString fileName, QString snapshotFileName, QStringList &log);
+    bool writeSnapshot(QString snapshotFileName, QStringList &log);
+    static QString defaultSnapshotFileName(QString fileName) { return fileName + ".snapshot"; }
+    QList<sCPTMetaData> getVisibleCPTs(QRectF boundary, int maxResults = 0);
+    QList<int> getVisibleCPTIndexes(QRectF boundary, int maxResults = 0);
+    const sCPTMetaData &cptMetaDataAt(int index) { return m_cptsMetaData.at(index); }
+    QList<VSoil *> getVisibleVSoils(QRectF boundary, int maxResults = 0);
     int getNumberOfCPTs() { return m_cptsMetaData.count(); }
     int getNumberOfSoilTypes() { return m_soilTypes.count(); }
     int getVSoilIdClosestTo(QPointF xy);
-
-    void importCPTS(QString path, QStringList &log);
+    QList<int> getVSoilIdsClosestTo(QPointF xy, int k);
+    QList<int> getVSoilIdsWithin(QPointF xy, double radius);
+
+    bool importCPTS(QString path, QStringList &log);
+    void setImportBatchSize(int batchSize) { m_importBatchSize = qMax(1, batchSize); }
+    int importBatchSize() { return m_importBatchSize; }
+    void setSoilClassifier(QSharedPointer<SoilClassifier> classifier, QStringList &log);
+    QSharedPointer<SoilClassifier> soilClassifier() { return m_soilClassifier; }
+    QStringList soilClassifierLog() { return m_soilClassifierLog; } //unmapped classes of the last time the soiltypes were mapped
+    void setCPTSegmentation(bool enabled, const sSegmentation &settings = CPT::defaultSegmentation());
     bool importVSoilFromTextFile(QString fileName, QStringList &log);
-
-    void generateGeoProfile2D(QList<QPointF> &latlonPoints);
+    bool convertVSoilData(QStringList &log);
+    bool loadCPT(const int id, CPT &cpt, QStringList &log);
+    bool storeMissingCPTData(QStringList &log);
+    bool regenerateCPTVSoils(QStringList &log, double minInterval = 0.1, bool includeUnmarked = false);
+
+    void generateGeoProfile2D(QList<QPointF> &latlonPoints, GeoProfileMethod method = SampledProfile);
+    void generateGeoProfile2DFromRD(const QList<QPointF> &rdPoints, GeoProfileMethod method = SampledProfile);
+    QFuture<GeoProfile2D*> generateGeoProfiles2D(const QList<QList<QPointF> > &polylines, GeoProfileMethod method = SampledProfile);
+    QFuture<GeoProfile2D*> generateGeoProfiles2DFromRD(const QList<QList<QPointF> > &rdPolylines, GeoProfileMethod method = SampledProfile);
+    void addGeoProfiles2D(const QList<GeoProfile2D*> &profiles);
+    void clearGeoProfiles2D();
     void setFilter(int code);
     void findWeakestSpot(const QRectF boundary, const int depth);
+    QList<sWeakSpot> findWeakestSpots(const QRectF boundary, const int depth, const int k);
+    bool getScoreRaster(const QRectF boundary, const int depth, const int columns, const int rows, sScoreRaster &raster);
 
     QList<sCPTMetaData> getCPTMetaDatas() { return m_cptsMetaData; }
     QList<GeoProfile2D*> getProfiles() { return m_geoProfile2Ds; }
@@ -41,6 +102,8 @@ public:
     SoilType* getSoilTypeById(int id);
     QString fileName() { return m_fileName; }
 
+    double getAverage(const int vsoilId, SoilType::Parameter parameter, double zTop, double zBottom);
+    double getAverage(VSoil *vs, SoilType::Parameter parameter, double zTop, double zBottom);
     double getAverageC(const int vsoilId, const int depth);
     double getAveragePhi(const int vsoilId, const int depth);
 
@@ -61,26 +124,79 @@ public:
     void getVSoilLocations(QStringList &locations);
 
 public slots:
+    //call this after changing the location, the layers or the enabled state of a vsoil directly
+    void invalidateSpatialIndex() { m_vsoilSnapshot.clear(); m_vsoilViewIndexValid = false; m_cptViewIndexValid = false; }
+    //the soiltypes of the datastore call this when their parameters change,
+    //the vsoils clear their own averages when their layers change
+    void invalidateLayerProperties() { m_layerPropertiesRevision++; }
     void saveChanges();
     void saveSoilTypes();
     void reloadSoilTypes();
 
+private slots:
+    void loaderSoilTypesLoaded(QList<SoilType*> soilTypes);
+    void loaderCPTsLoaded(QList<sCPTMetaData> cpts);
+    void loaderVSoilsLoaded(QList<VSoil*> vsoils);
+    void loaderFinished(bool ok, bool canceled);
+
 private:
     DBAdapter *m_db;    
     QList<sCPTMetaData> m_cptsMetaData; //a list containing all cpt's in the database
     QList<SoilType*> m_soilTypes; //a list containing all soiltypes from the db
     QList<VSoil*> m_vsoils; //a list containing all vsoil from the db
     QList<GeoProfile2D*> m_geoProfile2Ds; //a list containing all generated 2D geotechnical profiles
+    QHash<int, VSoil*> m_vsoilsById; //id lookup for m_vsoils
+    QHash<int, SoilType*> m_soilTypesById; //id lookup for m_soilTypes
 
     QString m_fileName; //the name of the database file
 
     void getSoilTypesByProfile(GeoProfile2D *geo, QList<SoilType*> &soilTypes);
+    void updateVSoilRegistry();
+    void updateSoilTypeRegistry();
+    void loadEntities();
+    void loadSoilTypeEntities();
+    void loadVSoilEntities();
+    void createEntityFacades();
+    void createSoilTypeFacades();
+    void createVSoilFacades();
+    void deleteSoilTypeFacades();
+    void deleteVSoilFacades();
+
+    QSharedPointer<const VSoilSnapshot> m_vsoilSnapshot; //enabled vsoils with a kd-tree on their rd coordinates, NULL if outdated
+    void updateVSoilSnapshot();
+    void updateProfileLimits(GeoProfile2D *geo);
+    bool updateLayerIntegral(VSoil *vs, SoilType::Parameter parameter);
+    void prepareWeakSpotScores(const QList<VSoil*> &vsoils);
+
+    RTree m_cptViewIndex; //r-tree on the longitude / latitude of all cpts
+    bool m_cptViewIndexValid;
+    RTree m_vsoilViewIndex; //r-tree on the longitude / latitude of all vsoils
+    bool m_vsoilViewIndexValid;
+    void updateViewIndexes();
 
     bool m_dataLoaded; //returns true if data is loaded into the store
+    int m_layerPropertiesRevision; //revision of the soiltype properties, see getAverage
+    int m_importBatchSize; //number of cpt files that are read in parallel during importCPTS
+    QSharedPointer<SoilClassifier> m_soilClassifier; //chart used to generate vsoils from cpts
+    QStringList m_soilClassifierLog; //see soilClassifierLog
+    DataStoreLoader *m_loader; //loads the database on m_loaderThread, NULL if not loading
+    QThread *m_loaderThread;
+    SnapshotFile *m_snapshotFile; //the view indexes may be attached to it, NULL if not loaded from a snapshot
+    EntityStore m_entities; //records of the soiltypes and vsoils, except for the ones of loadDataAsync
+    bool m_segmentCPTs; //generate vsoils by change points instead of fixed intervals
+    sSegmentation m_segmentation; //settings for m_segmentCPTs
 
 signals:
+    void error(QString message); //something went wrong, the calling function returns false
     void importingNextCPT(int currentCPTNumber);
     void sendTotalCPT(int numCPTs);
+    void loadDataProgress(int step, int numSteps); //loadData only, it blocks until it is done
+    //loadDataAsync
+    void loadProgress(int done, int total);
+    void soilTypesLoaded();
+    void cptsLoaded();
+    void vsoilsLoaded(int numVSoils); //emitted for every chunk, numVSoils is the total so far
+    void loadFinished(bool ok);
 };
 
 #endif // DATASTORE_H
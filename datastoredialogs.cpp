@@ -0,0 +1,48 @@
+#include "datastoredialogs.h"
+
+#include <QMessageBox>
+#include <QProgressDialog>
+
+DataStoreDialogs::DataStoreDialogs(DataStore *dataStore, QWidget *parentWidget) :
+    QObject(dataStore)
+{
+    m_parentWidget = parentWidget;
+    connect(dataStore, SIGNAL(error(QString)), this, SLOT(showError(QString)));
+    //only the blocking loadData gets a (modal) dialog, loadDataAsync keeps the GUI usable
+    connect(dataStore, SIGNAL(loadDataProgress(int,int)), this, SLOT(showLoadProgress(int,int)));
+}
+
+DataStoreDialogs::~DataStoreDialogs()
+{
+    delete m_progress;
+}
+
+void DataStoreDialogs::showError(QString message)
+{
+    closeLoadProgress();
+    QMessageBox::warning(m_parentWidget, tr("qBB3D"), message);
+}
+
+/*
+  Opens the progress dialog on the first step and closes it after the last
+  */
+void DataStoreDialogs::showLoadProgress(int done, int total)
+{
+    if(m_progress.isNull()){
+        m_progress = new QProgressDialog(tr("Reading database file..."), tr("Cancel"), 0, total, m_parentWidget);
+        m_progress->setCancelButton(NULL);
+        m_progress->setWindowModality(Qt::WindowModal);
+        m_progress->show();
+    }
+    m_progress->setMaximum(total);
+    m_progress->setValue(done);
+    if(done >= total)
+        closeLoadProgress();
+}
+
+void DataStoreDialogs::closeLoadProgress()
+{
+    if(!m_progress.isNull())
+        m_progress->deleteLater();
+    m_progress = NULL;
+}
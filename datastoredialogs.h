@@ -0,0 +1,34 @@
+#ifndef DATASTOREDIALOGS_H
+#define DATASTOREDIALOGS_H
+
+#include <QObject>
+#include <QPointer>
+
+#include "datastore.h"
+
+class QWidget;
+class QProgressDialog;
+
+/*
+    Part of the GUI add-on (libbbgeogui). Shows the errors of a DataStore in
+    a message box and the progress of loadData in a progress dialog, the core
+    library only reports them with signals so it can run without a display.
+ */
+class DataStoreDialogs : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DataStoreDialogs(DataStore *dataStore, QWidget *parentWidget = 0);
+    ~DataStoreDialogs();
+
+private slots:
+    void showError(QString message);
+    void showLoadProgress(int done, int total);
+    void closeLoadProgress();
+
+private:
+    QWidget *m_parentWidget; //parent of the dialogs, may be NULL
+    QPointer<QProgressDialog> m_progress; //only while loading
+};
+
+#endif // DATASTOREDIALOGS_H
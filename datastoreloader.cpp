@@ -0,0 +1,90 @@
+#include "datastoreloader.h"
+#include "dbadapter.h"
+
+#include <QThread>
+#include <QtConcurrentMap>
+#include <QDebug>
+
+/*
+  The layer data of one vsoil, parsed on the thread pool by parseVSoilBlob
+  */
+struct sVSoilBlob{
+    VSoil *vsoil;
+    QByteArray data;
+};
+
+static void parseVSoilBlob(sVSoilBlob &blob)
+{
+    blob.vsoil->blobToData(blob.data);
+    blob.data.clear();
+}
+
+DataStoreLoader::DataStoreLoader(const QString &fileName, QThread *targetThread, int chunkSize) :
+    QObject(NULL)
+{
+    m_fileName = fileName;
+    m_targetThread = targetThread;
+    m_chunkSize = qMax(1, chunkSize);
+    m_canceled.storeRelease(0);
+}
+
+void DataStoreLoader::load()
+{
+    //every loader gets its own connection, sqlite connections can not be shared between threads
+    QString connectionName = QString("DataStoreLoader_%1").arg(quintptr(this));
+    DBAdapter *db = new DBAdapter(NULL, connectionName);
+    if(!db->openDB(m_fileName)){
+        qDebug() << QString("DataStoreLoader could not open %1").arg(m_fileName);
+        delete db;
+        emit finished(false, false);
+        return;
+    }
+
+    int total = db->countRows("soiltypes") + db->countRows("cpt") + db->countRows("vsoil");
+    int done = 0;
+    emit progress(done, total);
+
+    //soiltypes first, the vsoils can not be drawn without them
+    QList<SoilType*> soilTypes;
+    db->getAllSoilTypes(soilTypes);
+    for(int i=0; i<soilTypes.count(); i++)
+        soilTypes[i]->moveToThread(m_targetThread);
+    done += soilTypes.count();
+    emit soilTypesLoaded(soilTypes);
+    emit progress(done, total);
+
+    if(!isCanceled()){
+        QList<sCPTMetaData> cpts;
+        db->getAllCPTs(cpts);
+        done += cpts.count();
+        emit cptsLoaded(cpts);
+        emit progress(done, total);
+    }
+
+    qint64 lastRowId = 0;
+    while(!isCanceled()){
+        QList<VSoil*> vsoils;
+        QList<QByteArray> data;
+        if(db->getVSoilsAfter(lastRowId, m_chunkSize, vsoils, data) == 0)
+            break;
+        QList<sVSoilBlob> blobs;
+        blobs.reserve(vsoils.count());
+        for(int i=0; i<vsoils.count(); i++){
+            sVSoilBlob blob;
+            blob.vsoil = vsoils[i];
+            blob.data = data[i];
+            blobs.append(blob);
+        }
+        data.clear();
+        QtConcurrent::blockingMap(blobs, parseVSoilBlob);
+        for(int i=0; i<vsoils.count(); i++)
+            vsoils[i]->moveToThread(m_targetThread);
+        done += vsoils.count();
+        emit vsoilsLoaded(vsoils);
+        emit progress(done, total);
+    }
+
+    db->closeDB();
+    delete db;
+    emit finished(!isCanceled(), isCanceled());
+}
@@ -0,0 +1,46 @@
+#ifndef DATASTORELOADER_H
+#define DATASTORELOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QAtomicInt>
+
+#include "cpt.h"
+#include "soiltype.h"
+#include "vsoil.h"
+
+/*
+    Reads a database on its own thread and sqlite connection, see
+    DataStore::loadDataAsync. The data is published in parts (soiltypes,
+    cpts and then the vsoils in chunks) as soon as a part is ready. The
+    published objects are moved to targetThread and owned by the receiver.
+    The layers of every chunk of vsoils are parsed on the thread pool.
+ */
+class DataStoreLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DataStoreLoader(const QString &fileName, QThread *targetThread, int chunkSize = 2000);
+
+    void cancel() { m_canceled.storeRelease(1); } //can be called from any thread
+    bool isCanceled() const { return m_canceled.loadAcquire() != 0; }
+
+public slots:
+    void load();
+
+signals:
+    void progress(int done, int total); //in rows
+    void soilTypesLoaded(QList<SoilType*> soilTypes);
+    void cptsLoaded(QList<sCPTMetaData> cpts);
+    void vsoilsLoaded(QList<VSoil*> vsoils);
+    void finished(bool ok, bool canceled);
+
+private:
+    QString m_fileName;
+    QThread *m_targetThread;
+    int m_chunkSize;
+    QAtomicInt m_canceled;
+};
+
+#endif // DATASTORELOADER_H
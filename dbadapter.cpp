@@ -1,17 +1,33 @@
 #include "dbadapter.h"
+#include "entitystore.h"
 
 #include <QDebug>
 #include <QSqlQuery>
 #include <QFile>
 #include <QDir>
+#include <QElapsedTimer>
 
-DBAdapter::DBAdapter(QObject *parent) :
+DBAdapter::DBAdapter(QObject *parent, const QString &connectionName) :
     QObject(parent)
 {
+    m_connectionName = connectionName;
+    m_bulkInsert = false;
+    m_flushSize = 1000;
+    m_pendingRows = 0;
+    m_nextCPTId = 0;
+    m_nextVSoilId = 0;
+    m_insertCPTQuery = NULL;
+    m_insertCPTDataQuery = NULL;
+    m_insertVSoilQuery = NULL;
+    m_updateVSoilDataQuery = NULL;
+    m_setGeneratedVSoilDataQuery = NULL;
 }
 
 DBAdapter::~DBAdapter()
 {
+    if (m_bulkInsert){
+        endBulkInsert();
+    }
     if (m_db.isOpen()){
         //qDebug() << "CLOSING DB";
         closeDB();
@@ -21,6 +37,11 @@ DBAdapter::~DBAdapter()
 void DBAdapter::closeDB()
 {
     m_db.close();
+    if(!m_connectionName.isEmpty()){
+        //a named connection can only be removed if nothing refers to it anymore
+        m_db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
 }
 
 /*
@@ -28,7 +49,7 @@ void DBAdapter::closeDB()
  */
 int DBAdapter::getMaxIDFromCPT()
 {
-    QSqlQuery qry;
+    QSqlQuery qry(m_db);
     qry.exec("SELECT max(id) FROM cpt");
     if (qry.first())
         return qry.value(0).toInt();
@@ -38,7 +59,7 @@ int DBAdapter::getMaxIDFromCPT()
 
 int DBAdapter::getMaxIDFromVSoil()
 {
-    QSqlQuery qry;
+    QSqlQuery qry(m_db);
     qry.exec("SELECT max(id) FROM vsoil");
     if (qry.first())
         return qry.value(0).toInt();
@@ -49,7 +70,7 @@ int DBAdapter::getMaxIDFromVSoil()
 
 void DBAdapter::getAllCPTs(QList<sCPTMetaData> &cptsMetaData)
 {
-    QSqlQuery qry;
+    QSqlQuery qry(m_db);
     sCPTMetaData md;
 
     cptsMetaData.clear();
@@ -63,6 +84,7 @@ void DBAdapter::getAllCPTs(QList<sCPTMetaData> &cptsMetaData)
         md.zmax = qry.value(4).toDouble();
         md.zmin = qry.value(5).toDouble();
         md.fileName = qry.value(6).toString();
+        md.vsoilId = qry.value(7).isNull() ? -1 : qry.value(7).toInt();
         md.latitude = qry.value(8).toDouble();
         md.longitude = qry.value(9).toDouble();
         md.name = qry.value(10).toString();
@@ -71,74 +93,176 @@ void DBAdapter::getAllCPTs(QList<sCPTMetaData> &cptsMetaData)
     //qDebug() << "Aantal sonderingen: " << cptsMetaData.count();
 }
 
+/*
+  Reads the soiltype columns of the current row of qry
+ */
+static void soilTypeRecordFromQuery(const QSqlQuery &qry, sSoilTypeRecord &r)
+{
+    r.id = qry.value(0).toInt();
+    r.name = qry.value(1).toString();
+    r.description = qry.value(2).toString();
+    r.source = qry.value(3).toString();
+    r.parameters[SoilType::YDry] = qry.value(4).toDouble();
+    r.parameters[SoilType::YSat] = qry.value(5).toDouble();
+    r.parameters[SoilType::C] = qry.value(6).toDouble();
+    r.parameters[SoilType::Phi] = qry.value(7).toDouble();
+    r.parameters[SoilType::Upsilon] = qry.value(8).toDouble();
+    r.parameters[SoilType::K] = qry.value(9).toDouble();
+    r.parameters[SoilType::MCUpsilon] = qry.value(10).toDouble();
+    r.parameters[SoilType::MCE50] = qry.value(11).toDouble();
+    r.parameters[SoilType::HSE50] = qry.value(12).toDouble();
+    r.parameters[SoilType::HSEoed] = qry.value(13).toDouble();
+    r.parameters[SoilType::HSEur] = qry.value(14).toDouble();
+    r.parameters[SoilType::HSm] = qry.value(15).toDouble();
+    r.parameters[SoilType::SSCLambda] = qry.value(16).toDouble();
+    r.parameters[SoilType::SSCLambda] = qry.value(17).toDouble();
+    r.parameters[SoilType::SSCKappa] = qry.value(18).toDouble();
+    r.parameters[SoilType::Cp] = qry.value(19).toDouble();
+    r.parameters[SoilType::Cs] = qry.value(20).toDouble();
+    r.parameters[SoilType::Cap] = qry.value(21).toDouble();
+    r.parameters[SoilType::Cas] = qry.value(22).toDouble();
+    r.parameters[SoilType::Cv] = qry.value(23).toDouble();
+    r.color = qry.value(24).toString();
+}
+
 void DBAdapter::getAllSoilTypes(QList<SoilType*> &soilTypes)
 {
     soilTypes.clear();
-    QSqlQuery qry;
+    QSqlQuery qry(m_db);
     SoilType *st;
     qry.exec("SELECT * FROM soiltypes");
     while (qry.next()) {
         st = new SoilType();
-        st->setId(qry.value(0).toInt());
-        st->setName(qry.value(1).toString());
-        st->setDescription(qry.value(2).toString());
-        st->setSource(qry.value(3).toString());
-        st->setYdry(qry.value(4).toDouble());
-        st->setYsat(qry.value(5).toDouble());
-        st->setC(qry.value(6).toDouble());
-        st->setPhi(qry.value(7).toDouble());
-        st->setUpsilon(qry.value(8).toDouble());
-        st->setK(qry.value(9).toDouble());
-        st->setMCUpsilon(qry.value(10).toDouble());
-        st->setMCE50(qry.value(11).toDouble());
-        st->setHSE50(qry.value(12).toDouble());
-        st->setHSEoed(qry.value(13).toDouble());
-        st->setHSEur(qry.value(14).toDouble());
-        st->setHSm(qry.value(15).toDouble());
-        st->setSSClambda(qry.value(16).toDouble());
-        st->setSSClambda(qry.value(17).toDouble());
-        st->setSSCkappa(qry.value(18).toDouble());
-        st->setCp(qry.value(19).toDouble());
-        st->setCs(qry.value(20).toDouble());
-        st->setCap(qry.value(21).toDouble());
-        st->setCas(qry.value(22).toDouble());
-        st->setCv(qry.value(23).toDouble());
-        st->setColor(qry.value(24).toString());
+        soilTypeRecordFromQuery(qry, *st->record());
         soilTypes.append(st);
     }
     //qDebug() << "Aantal grondsoorten: " << soilTypes.count();
 }
 
+/*
+  Reads all soiltypes into the store, see EntityStore::loadFromDatabase
+ */
+void DBAdapter::getAllSoilTypes(EntityStore &store)
+{
+    QSqlQuery qry(m_db);
+    qry.setForwardOnly(true);
+    qry.exec("SELECT * FROM soiltypes");
+    while (qry.next()) {
+        sSoilTypeRecord *r = store.soilTypes().append(qry.value(0).toInt()); //keeps duplicate ids like getAllSoilTypes
+        soilTypeRecordFromQuery(qry, *r);
+        r->source = store.intern(r->source);
+    }
+}
+
+/*
+  Reads the vsoil columns of the current row of qry, the columns start at
+  first. The layer data is not parsed.
+ */
+static void vsoilRecordFromQuery(const QSqlQuery &qry, int first, sVSoilRecord &r)
+{
+    r.id = qry.value(first).toInt();
+    r.x = qry.value(first + 1).toDouble();
+    r.y = qry.value(first + 2).toDouble();
+    r.lat = qry.value(first + 3).toDouble();
+    r.lng = qry.value(first + 4).toDouble();
+    r.source = qry.value(first + 5).toString();
+    r.name = qry.value(first + 7).toString().trimmed();
+    r.leveeLocation = qry.value(first + 8).toInt();
+}
+
+static VSoil *vsoilFromQuery(const QSqlQuery &qry, int first)
+{
+    VSoil *vs = new VSoil();
+    vsoilRecordFromQuery(qry, first, *vs->record());
+    return vs;
+}
+
 void DBAdapter::getAllVSoils(QList<VSoil *> &vsoils)
 {
     vsoils.clear();
-    QSqlQuery qry;
+    QSqlQuery qry(m_db);
     VSoil *vs;
     qry.exec("SELECT * FROM vsoil");
     while (qry.next()) {
-        vs = new VSoil();
-        vs->setId(qry.value(0).toInt());
-        vs->setX(qry.value(1).toDouble());
-        vs->setY(qry.value(2).toDouble());
-        vs->setLatitude(qry.value(3).toDouble());
-        vs->setLongitude(qry.value(4).toDouble());
-        vs->setSource(qry.value(5).toString());
-        vs->blobToData(qry.value(6).toString());
-        vs->setName(qry.value(7).toString().trimmed());
-        vs->setLeveeLocation(qry.value(8).toInt());
+        vs = vsoilFromQuery(qry, 0);
+        vs->blobToData(qry.value(6).toByteArray());
         vsoils.append(vs);
     }
     //qDebug() << "Aantal vsoil: " << vsoils.count();
 }
 
+/*
+  Reads all vsoils with their layers into the store, see
+  EntityStore::loadFromDatabase. Returns the number of vsoils that were read.
+ */
+int DBAdapter::getAllVSoils(EntityStore &store)
+{
+    store.vsoils().reserve(countRows("vsoil"));
+    QSqlQuery qry(m_db);
+    qry.setForwardOnly(true);
+    qry.exec("SELECT * FROM vsoil");
+    int count = 0;
+    while (qry.next()) {
+        sVSoilRecord *r = store.vsoils().append(qry.value(0).toInt()); //keeps duplicate ids like getAllVSoils
+        vsoilRecordFromQuery(qry, 0, *r);
+        r->source = store.intern(r->source);
+        if(!VSoil::blobToLayers(qry.value(6).toByteArray(), r->layers))
+            qDebug() << "Error in DBAdapter::getAllVSoils; invalid layer data for vsoil id =" << r->id;
+        count++;
+    }
+    return count;
+}
+
+/*
+  Reads at most limit vsoils that come after the row lastRowId in the order
+  of getAllVSoils, without parsing their layer data (see VSoil::blobToData).
+  lastRowId is set to the row of the last vsoil, start with 0.
+  Returns the number of vsoils that were read.
+ */
+int DBAdapter::getVSoilsAfter(qint64 &lastRowId, int limit, QList<VSoil *> &vsoils, QList<QByteArray> &blobs)
+{
+    QSqlQuery qry(m_db);
+    qry.setForwardOnly(true);
+    qry.prepare("SELECT rowid, * FROM vsoil WHERE rowid > ? ORDER BY rowid LIMIT ?");
+    qry.bindValue(0, lastRowId);
+    qry.bindValue(1, limit);
+    qry.exec();
+    int count = 0;
+    while (qry.next()) {
+        lastRowId = qry.value(0).toLongLong();
+        vsoils.append(vsoilFromQuery(qry, 1));
+        blobs.append(qry.value(7).toByteArray());
+        count++;
+    }
+    return count;
+}
+
+/*
+  Returns the number of rows in table (cpt, soiltypes or vsoil)
+ */
+int DBAdapter::countRows(const QString &table)
+{
+    QSqlQuery qry(m_db);
+    qry.exec(QString("SELECT count(*) FROM %1").arg(table));
+    if (qry.first())
+        return qry.value(0).toInt();
+    return 0;
+}
+
 void DBAdapter::addCPT(CPT *cpt, const int vsoilId, QSqlError &err)
 {
     //first check if the x and y are unique
     if(isUniqueCPT(QPointF(cpt->x(), cpt->y()))){
-        cpt->setId(getMaxIDFromCPT() + 1);
+        if(m_bulkInsert){
+            cpt->setId(m_nextCPTId); //only taken once the row is inserted
+        }else{
+            cpt->setId(getMaxIDFromCPT() + 1);
+        }
         QByteArray blob = cpt->dataAsQByteArray();
-        QSqlQuery qry;
-        qry.prepare("INSERT INTO cpt VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        QSqlQuery localQry(m_db);
+        QSqlQuery &qry = m_bulkInsert ? *m_insertCPTQuery : localQry;
+        if(!m_bulkInsert)
+            qry.prepare("INSERT INTO cpt VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
         qry.bindValue(0, cpt->id());
         qry.bindValue(1, cpt->date());
         qry.bindValue(2, cpt->x());
@@ -152,18 +276,77 @@ void DBAdapter::addCPT(CPT *cpt, const int vsoilId, QSqlError &err)
         qry.bindValue(10, cpt->name());
         qry.exec();
         err = qry.lastError();
+        if(m_bulkInsert && !err.isValid())
+            m_nextCPTId++;
+        if(!err.isValid())
+            insertCPTData(cpt->id(), blob, err);
+        if(m_bulkInsert && !err.isValid()){
+            m_cptLocations.insert(qMakePair(cpt->x(), cpt->y()));
+            bulkRowAdded();
+        }
     }else{
         //TODO: foutmelding dat de xy al bezet is
     }
 }
 
+bool DBAdapter::insertCPTData(const int cptId, const QByteArray &data, QSqlError &err)
+{
+    QSqlQuery localQry(m_db);
+    QSqlQuery &qry = m_bulkInsert ? *m_insertCPTDataQuery : localQry;
+    if(!m_bulkInsert)
+        qry.prepare("INSERT OR REPLACE INTO cpt_data VALUES(?, ?)");
+    qry.bindValue(0, cptId);
+    qry.bindValue(1, data);
+    qry.exec();
+    err = qry.lastError();
+    return !err.isValid();
+}
+
+/*
+  Stores (or replaces) the measurements of the cpt with the given id,
+  data is the result of CPT::dataAsQByteArray
+ */
+void DBAdapter::setCPTData(const int cptId, const QByteArray &data, QSqlError &err)
+{
+    if(insertCPTData(cptId, data, err) && m_bulkInsert)
+        bulkRowAdded();
+}
+
+/*
+  Reads the measurements of the cpt with the given id, returns false if they
+  are not in the database (for example cpts imported before they were stored)
+ */
+bool DBAdapter::getCPTData(const int cptId, QByteArray &data, QSqlError &err)
+{
+    QSqlQuery qry(m_db);
+    qry.prepare("SELECT data FROM cpt_data WHERE cpt_id=?");
+    qry.bindValue(0, cptId);
+    qry.exec();
+    err = qry.lastError();
+    if(!qry.next())
+        return false;
+    data = qry.value(0).toByteArray();
+    return true;
+}
+
+void DBAdapter::getCPTIdsWithData(QSet<int> &ids)
+{
+    ids.clear();
+    QSqlQuery qry(m_db);
+    qry.exec("SELECT cpt_id FROM cpt_data");
+    while (qry.next())
+        ids.insert(qry.value(0).toInt());
+}
+
 /*
   Returns true if there is no entry in the cpt table that
   has the x,y coords given in point.
  */
 bool DBAdapter::isUniqueCPT(QPointF point)
 {
-    QSqlQuery qry;
+    if(m_bulkInsert)
+        return !m_cptLocations.contains(qMakePair(point.x(), point.y()));
+    QSqlQuery qry(m_db);
     qry.prepare("SELECT * FROM cpt WHERE x=? AND y=?");
     qry.bindValue(0, point.x());
     qry.bindValue(1, point.y());
@@ -173,7 +356,9 @@ bool DBAdapter::isUniqueCPT(QPointF point)
 
 bool DBAdapter::isUniqueVSoil(QPointF point)
 {
-    QSqlQuery qry;
+    if(m_bulkInsert)
+        return !m_vsoilLocations.contains(qMakePair(point.x(), point.y()));
+    QSqlQuery qry(m_db);
     qry.prepare("SELECT * FROM vsoil WHERE x=? AND y=?");
     qry.bindValue(0, point.x());
     qry.bindValue(1, point.y());
@@ -183,7 +368,7 @@ bool DBAdapter::isUniqueVSoil(QPointF point)
 
 void DBAdapter::getVSoilSources(QStringList &sources)
 {
-    QSqlQuery qry;
+    QSqlQuery qry(m_db);
     qry.prepare("SELECT DISTINCT source FROM vsoil");
     qry.exec();
     while (qry.next()) {
@@ -194,21 +379,32 @@ void DBAdapter::getVSoilSources(QStringList &sources)
 void DBAdapter::addVSoil(VSoil &vsoil, QSqlError &err)
 {
     if(isUniqueVSoil(QPointF(vsoil.x(), vsoil.y()))){
-        vsoil.setId(getMaxIDFromVSoil() + 1);
+        if(m_bulkInsert){
+            vsoil.setId(m_nextVSoilId); //only taken once the row is inserted
+        }else{
+            vsoil.setId(getMaxIDFromVSoil() + 1);
+        }
         QByteArray blob = vsoil.dataAsQByteArray();
-        QSqlQuery qry;
-        qry.prepare("INSERT INTO vsoil VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        QSqlQuery localQry(m_db);
+        QSqlQuery &qry = m_bulkInsert ? *m_insertVSoilQuery : localQry;
+        if(!m_bulkInsert)
+            qry.prepare("INSERT INTO vsoil VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?)");
         qry.bindValue(0, vsoil.id());
         qry.bindValue(1, vsoil.x());
         qry.bindValue(2, vsoil.y());
         qry.bindValue(3, vsoil.latitude());
         qry.bindValue(4, vsoil.longitude());
         qry.bindValue(5, vsoil.source());
-        qry.bindValue(6, blob.data());
+        qry.bindValue(6, blob);
         qry.bindValue(7, vsoil.name());
         qry.bindValue(8, vsoil.levee_location());
         qry.exec();
         err = qry.lastError();
+        if(m_bulkInsert && !err.isValid()){
+            m_nextVSoilId++;
+            m_vsoilLocations.insert(qMakePair(vsoil.x(), vsoil.y()));
+            bulkRowAdded();
+        }
     }else{
         //TODO: foutmelding dat de xy al bezet is
     }
@@ -216,7 +412,7 @@ void DBAdapter::addVSoil(VSoil &vsoil, QSqlError &err)
 
 void DBAdapter::updateVSoil(VSoil *vsoil, QSqlError &err){
     QByteArray blob = vsoil->dataAsQByteArray();
-    QSqlQuery qry;
+    QSqlQuery qry(m_db);
 
     qry.prepare("UPDATE vsoil SET x=:x, y=:y, latitude=:lat, longitude=:lon, source=:src, data=:data, name=:name, levee_location=:levee_location WHERE id=:id");
 
@@ -225,7 +421,7 @@ void DBAdapter::updateVSoil(VSoil *vsoil, QSqlError &err){
     qry.bindValue(":lat", vsoil->latitude());
     qry.bindValue(":lon", vsoil->longitude());
     qry.bindValue(":src", vsoil->source());
-    qry.bindValue(":data", blob.data());
+    qry.bindValue(":data", blob);
     qry.bindValue(":id", vsoil->id());
     qry.bindValue(":name", vsoil->name());
     qry.bindValue(":levee_location", vsoil->levee_location());
@@ -234,9 +430,111 @@ void DBAdapter::updateVSoil(VSoil *vsoil, QSqlError &err){
     err = qry.lastError();
 }
 
+/*
+  Replaces the layers of the vsoil with the given id, data is the result of
+  VSoil::dataAsQByteArray. Counts as a bulk row during a bulk insert.
+ */
+void DBAdapter::updateVSoilData(const int vsoilId, const QByteArray &data, QSqlError &err)
+{
+    QSqlQuery localQry(m_db);
+    QSqlQuery &qry = m_bulkInsert ? *m_updateVSoilDataQuery : localQry;
+    if(!m_bulkInsert)
+        qry.prepare("UPDATE vsoil SET data=? WHERE id=?");
+    qry.bindValue(0, data);
+    qry.bindValue(1, vsoilId);
+    qry.exec();
+    err = qry.lastError();
+    if(m_bulkInsert && !err.isValid())
+        bulkRowAdded();
+}
+
+/*
+  Stores the layers of the vsoil with the given id as they were generated
+  from its cpt, see DataStore::regenerateCPTVSoils. The vsoil is unedited as
+  long as its layers are the same as these.
+ */
+void DBAdapter::setGeneratedVSoilData(const int vsoilId, const QByteArray &data, QSqlError &err)
+{
+    QSqlQuery localQry(m_db);
+    QSqlQuery &qry = m_bulkInsert ? *m_setGeneratedVSoilDataQuery : localQry;
+    if(!m_bulkInsert)
+        qry.prepare("INSERT OR REPLACE INTO vsoil_generated VALUES(?, ?)");
+    qry.bindValue(0, vsoilId);
+    qry.bindValue(1, data);
+    qry.exec();
+    err = qry.lastError();
+}
+
+/*
+  Reads the generated layers of all vsoils that have them, by vsoil id
+ */
+void DBAdapter::getGeneratedVSoilData(QHash<int, QByteArray> &data)
+{
+    data.clear();
+    QSqlQuery qry(m_db);
+    qry.exec("SELECT vsoil_id, data FROM vsoil_generated");
+    while (qry.next())
+        data.insert(qry.value(0).toInt(), qry.value(1).toByteArray());
+}
+
+/*
+  Rewrites all vsoil layer data that is still in the legacy text layout in
+  the binary layout, in one transaction. converted returns the number of
+  rewritten vsoils. On an error nothing is changed.
+ */
+bool DBAdapter::convertVSoilBlobs(int &converted, QSqlError &err)
+{
+    converted = 0;
+    if(m_bulkInsert){
+        qDebug() << "Error in DBAdapter::convertVSoilBlobs; not possible during a bulk insert";
+        return false;
+    }
+    //collect first, sqlite does not like updates on the table that is being read
+    //by rowid, the vsoil ids do not have to be unique
+    QList<QPair<qint64, QByteArray> > legacy;
+    QSqlQuery qry(m_db);
+    qry.exec("SELECT rowid, data FROM vsoil");
+    while (qry.next()) {
+        QByteArray data = qry.value(1).toByteArray();
+        if(!VSoil::isBinaryBlob(data))
+            legacy.append(qMakePair(qry.value(0).toLongLong(), data));
+    }
+    err = qry.lastError();
+    if(err.isValid())
+        return false;
+    if(legacy.count()==0)
+        return true;
+
+    if(!m_db.transaction()){
+        err = m_db.lastError();
+        return false;
+    }
+    QSqlQuery update(m_db);
+    update.prepare("UPDATE vsoil SET data=? WHERE rowid=?");
+    for(int i=0; i<legacy.count(); i++){
+        VSoil vs;
+        vs.blobToData(legacy[i].second);
+        update.bindValue(0, vs.dataAsQByteArray());
+        update.bindValue(1, legacy[i].first);
+        update.exec();
+        err = update.lastError();
+        if(err.isValid()){
+            m_db.rollback();
+            return false;
+        }
+    }
+    if(!m_db.commit()){
+        err = m_db.lastError();
+        m_db.rollback();
+        return false;
+    }
+    converted = legacy.count();
+    return true;
+}
+
 void DBAdapter::updateSoilType(SoilType *st, QSqlError &err)
 {
-    QSqlQuery qry;
+    QSqlQuery qry(m_db);
     qry.prepare("UPDATE soiltypes SET name=:name, description=:description, source=:source, " \
                 "ydry=:ydry, ysat=:ysat, c=:c, phi=:phi, upsilon=:upsilon, k=:k, " \
                 "MC_upsilon=:MC_upsilon, MC_E50=:MC_E50, HS_E50=:HS_E50, HS_Eoed=:HS_Eoed, "\
@@ -273,6 +571,105 @@ void DBAdapter::updateSoilType(SoilType *st, QSqlError &err)
     err = qry.lastError();
 }
 
+/*
+  Starts a bulk insert. Until endBulkInsert is called addCPT and addVSoil
+  - run inside one transaction which is committed every flushSize rows
+  - reuse the same prepared INSERT statements
+  - take their ids from in memory counters that are seeded once from the db
+  - check for unique coordinates against in memory sets instead of a SELECT
+  The time every commit takes is reported by bulkBatchCommitted and kept in
+  bulkCommitLatencies.
+ */
+bool DBAdapter::beginBulkInsert(int flushSize)
+{
+    if(m_bulkInsert){
+        qDebug() << "DBAdapter::beginBulkInsert called during a bulk insert";
+        return false;
+    }
+    m_flushSize = qMax(1, flushSize);
+    m_pendingRows = 0;
+    m_commitLatencies.clear();
+    m_nextCPTId = getMaxIDFromCPT() + 1;
+    m_nextVSoilId = getMaxIDFromVSoil() + 1;
+
+    m_cptLocations.clear();
+    m_vsoilLocations.clear();
+    QSqlQuery qry(m_db);
+    qry.exec("SELECT x, y FROM cpt");
+    while (qry.next())
+        m_cptLocations.insert(qMakePair(qry.value(0).toDouble(), qry.value(1).toDouble()));
+    qry.exec("SELECT x, y FROM vsoil");
+    while (qry.next())
+        m_vsoilLocations.insert(qMakePair(qry.value(0).toDouble(), qry.value(1).toDouble()));
+
+    if(!m_db.transaction()){
+        qDebug() << "DBERROR: could not start transaction" << m_db.lastError();
+        return false;
+    }
+    m_insertCPTQuery = new QSqlQuery(m_db);
+    m_insertCPTQuery->prepare("INSERT INTO cpt VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    m_insertCPTDataQuery = new QSqlQuery(m_db);
+    m_insertCPTDataQuery->prepare("INSERT OR REPLACE INTO cpt_data VALUES(?, ?)");
+    m_insertVSoilQuery = new QSqlQuery(m_db);
+    m_insertVSoilQuery->prepare("INSERT INTO vsoil VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    m_updateVSoilDataQuery = new QSqlQuery(m_db);
+    m_updateVSoilDataQuery->prepare("UPDATE vsoil SET data=? WHERE id=?");
+    m_setGeneratedVSoilDataQuery = new QSqlQuery(m_db);
+    m_setGeneratedVSoilDataQuery->prepare("INSERT OR REPLACE INTO vsoil_generated VALUES(?, ?)");
+    m_bulkInsert = true;
+    return true;
+}
+
+/*
+  Commits the remaining rows and returns to the normal (autocommit) mode
+ */
+bool DBAdapter::endBulkInsert()
+{
+    if(!m_bulkInsert)
+        return false;
+    bool result = commitBulkBatch();
+    delete m_insertCPTQuery;
+    m_insertCPTQuery = NULL;
+    delete m_insertCPTDataQuery;
+    m_insertCPTDataQuery = NULL;
+    delete m_insertVSoilQuery;
+    m_insertVSoilQuery = NULL;
+    delete m_updateVSoilDataQuery;
+    m_updateVSoilDataQuery = NULL;
+    delete m_setGeneratedVSoilDataQuery;
+    m_setGeneratedVSoilDataQuery = NULL;
+    m_cptLocations.clear();
+    m_vsoilLocations.clear();
+    m_bulkInsert = false;
+    return result;
+}
+
+void DBAdapter::bulkRowAdded()
+{
+    m_pendingRows++;
+    if(m_pendingRows >= m_flushSize){
+        commitBulkBatch();
+        if(!m_db.transaction()){
+            qDebug() << "DBERROR: could not start transaction" << m_db.lastError();
+        }
+    }
+}
+
+bool DBAdapter::commitBulkBatch()
+{
+    QElapsedTimer timer;
+    timer.start();
+    bool result = m_db.commit();
+    qint64 msecs = timer.elapsed();
+    if(!result){
+        qDebug() << "DBERROR: could not commit transaction" << m_db.lastError();
+    }
+    m_commitLatencies.append(msecs);
+    emit bulkBatchCommitted(m_pendingRows, msecs);
+    m_pendingRows = 0;
+    return result;
+}
+
 bool DBAdapter::isOpen()
 {
     return m_db.isOpen();
@@ -295,7 +692,7 @@ bool DBAdapter::createNew(QString filename)
                  sql.append(in.readLine());
          }
 
-        QSqlQuery qry;
+        QSqlQuery qry(m_db);
         qry.exec(                  )
         return true;
     }else{
@@ -308,7 +705,19 @@ bool DBAdapter::createNew(QString filename)
 bool DBAdapter::openDB(QString filename)
 {
     //qDebug() << "OPENING DB";
-    m_db = QSqlDatabase::addDatabase("QSQLITE");
+    if(m_connectionName.isEmpty())
+        m_db = QSqlDatabase::addDatabase("QSQLITE");
+    else
+        m_db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
     m_db.setDatabaseName(filename);
-    return m_db.open();
+    if(!m_db.open())
+        return false;
+    //the measurements of the cpts, added later so older databases may not have it
+    QSqlQuery qry(m_db);
+    if(!qry.exec("CREATE TABLE IF NOT EXISTS cpt_data (cpt_id INTEGER PRIMARY KEY, data BLOB)"))
+        qDebug() << "DBERROR: could not create the cpt_data table" << qry.lastError();
+    //the layers of the cpt vsoils as generated, to tell them from edited ones
+    if(!qry.exec("CREATE TABLE IF NOT EXISTS vsoil_generated (vsoil_id INTEGER PRIMARY KEY, data BLOB)"))
+        qDebug() << "DBERROR: could not create the vsoil_generated table" << qry.lastError();
+    return true;
 }
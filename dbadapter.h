@@ -4,18 +4,24 @@
 #include <QObject>
 #include <QSqlDatabase>
 #include <QSqlError>
+#include <QSqlQuery>
 #include <QString>
 #include <QPointF>
+#include <QSet>
+#include <QHash>
+#include <QPair>
 
 #include "soiltype.h"
 #include "vsoil.h"
 #include "cpt.h"
 
+class EntityStore;
+
 class DBAdapter : public QObject
 {
     Q_OBJECT
 public:
-    explicit DBAdapter(QObject *parent = 0);
+    explicit DBAdapter(QObject *parent = 0, const QString &connectionName = QString());
     ~DBAdapter();
     bool openDB(QString filename);
     void closeDB();
@@ -25,23 +31,60 @@ public:
     void getAllCPTs(QList<sCPTMetaData> &cptsMetaData);
     void getAllSoilTypes(QList<SoilType *> &soilTypes);
     void getAllVSoils(QList<VSoil *> &vsoils);
+    void getAllSoilTypes(EntityStore &store);
+    int getAllVSoils(EntityStore &store);
+    int getVSoilsAfter(qint64 &lastRowId, int limit, QList<VSoil *> &vsoils, QList<QByteArray> &blobs);
+    int countRows(const QString &table);
 
     void addCPT(CPT *cpt, const int vsoilId, QSqlError &err);
+    void setCPTData(const int cptId, const QByteArray &data, QSqlError &err);
+    bool getCPTData(const int cptId, QByteArray &data, QSqlError &err);
+    void getCPTIdsWithData(QSet<int> &ids);
     void addVSoil(VSoil &vsoil, QSqlError &err);
     void updateVSoil(VSoil *vsoil, QSqlError &err);
+    void updateVSoilData(const int vsoilId, const QByteArray &data, QSqlError &err);
+    void setGeneratedVSoilData(const int vsoilId, const QByteArray &data, QSqlError &err);
+    void getGeneratedVSoilData(QHash<int, QByteArray> &data);
     void updateSoilType(SoilType *st, QSqlError &err);
+    bool convertVSoilBlobs(int &converted, QSqlError &err);
 
     bool isUniqueCPT(QPointF point);
     bool isUniqueVSoil(QPointF point);
     void getVSoilSources(QStringList &sources);    
 
+    bool beginBulkInsert(int flushSize = 1000);
+    bool endBulkInsert();
+    bool inBulkInsert() { return m_bulkInsert; }
+    QList<qint64> bulkCommitLatencies() { return m_commitLatencies; } //msecs per committed batch
+
 private:
     QSqlDatabase m_db;
+    QString m_connectionName; //empty for the default connection
     int getMaxIDFromCPT();
     int getMaxIDFromVSoil();
+    bool insertCPTData(const int cptId, const QByteArray &data, QSqlError &err);
+
+    //bulk insert state, see beginBulkInsert
+    bool m_bulkInsert;
+    int m_flushSize;
+    int m_pendingRows;
+    int m_nextCPTId;
+    int m_nextVSoilId;
+    QSqlQuery *m_insertCPTQuery;
+    QSqlQuery *m_insertCPTDataQuery;
+    QSqlQuery *m_insertVSoilQuery;
+    QSqlQuery *m_updateVSoilDataQuery;
+    QSqlQuery *m_setGeneratedVSoilDataQuery;
+    QSet<QPair<double, double> > m_cptLocations;
+    QSet<QPair<double, double> > m_vsoilLocations;
+    QList<qint64> m_commitLatencies;
+
+    void bulkRowAdded();
+    bool commitBulkBatch();
 
 signals:
-    
+    void bulkBatchCommitted(int rows, qint64 msecs);
+
 public slots:
     
 };
@@ -0,0 +1,198 @@
+#include "entitystore.h"
+#include "dbadapter.h"
+#include "snapshotfile.h"
+
+#include <QDebug>
+
+EntityStore::EntityStore()
+{
+}
+
+EntityStore::~EntityStore()
+{
+    clear();
+}
+
+void EntityStore::clear()
+{
+    m_vsoilIndex.clear();
+    m_vsoilIndexSlots.clear();
+    m_cpts.clear();
+    m_vsoils.clear();
+    m_soilTypes.clear();
+    m_strings.clear();
+}
+
+/*
+  Returns a copy of s that shares its data with all earlier interned copies
+  of the same text, thousands of vsoils with the same source then use one
+  string
+  */
+QString EntityStore::intern(const QString &s)
+{
+    QSet<QString>::const_iterator it = m_strings.constFind(s);
+    if(it != m_strings.constEnd())
+        return *it;
+    m_strings.insert(s);
+    return s;
+}
+
+/*
+  Reads the cpt metadata, soiltypes and vsoils from a database. The
+  database is opened on a connection of its own so this can run next to a
+  DataStore or on another thread.
+  */
+bool EntityStore::loadFromDatabase(const QString &fileName, QStringList &log)
+{
+    clear();
+    QString connectionName = QString("EntityStore_%1").arg(quintptr(this));
+    DBAdapter *db = new DBAdapter(NULL, connectionName);
+    if(!db->openDB(fileName)){
+        log.append(QString("Could not open the database %1").arg(fileName));
+        delete db;
+        return false;
+    }
+
+    QList<sCPTMetaData> cpts;
+    db->getAllCPTs(cpts);
+    m_cpts = cpts.toVector();
+    db->getAllSoilTypes(*this);
+    int count = db->getAllVSoils(*this);
+    db->closeDB();
+    delete db;
+
+    updateVSoilIndex();
+    log.append(QString("Loaded %1 cpts, %2 soiltypes and %3 vsoils from %4")
+               .arg(m_cpts.count()).arg(m_soilTypes.count()).arg(count).arg(fileName));
+    return true;
+}
+
+/*
+  Copies the records of an open snapshot into the store, the snapshot
+  can be closed afterwards
+  */
+bool EntityStore::loadFromSnapshot(const SnapshotFile &snapshot, QStringList &log)
+{
+    clear();
+    if(!snapshot.isOpen()){
+        log.append("Trying to load from a snapshot that is not open.");
+        return false;
+    }
+
+    m_soilTypes.reserve(snapshot.soilTypeCount());
+    for(int i=0; i<snapshot.soilTypeCount(); i++){
+        const sSnapshotSoilType &r = snapshot.soilType(i);
+        sSoilTypeRecord *st = m_soilTypes.append(r.id);
+        for(int p=0; p<SNAPSHOT_NUM_PARAMETERS; p++)
+            st->parameters[p] = r.parameters[p];
+        st->name = snapshot.string(r.name);
+        st->description = snapshot.string(r.description);
+        st->source = intern(snapshot.string(r.source));
+        st->color = snapshot.string(r.color);
+    }
+
+    m_cpts.reserve(snapshot.cptCount());
+    for(int i=0; i<snapshot.cptCount(); i++){
+        const sSnapshotCPT &r = snapshot.cpt(i);
+        sCPTMetaData md;
+        md.id = r.id;
+        md.vsoilId = r.vsoilId;
+        md.x = r.x;
+        md.y = r.y;
+        md.latitude = r.latitude;
+        md.longitude = r.longitude;
+        md.zmax = r.zmax;
+        md.zmin = r.zmin;
+        md.date = QDateTime::fromMSecsSinceEpoch(r.date);
+        md.fileName = snapshot.string(r.fileName);
+        md.name = snapshot.string(r.name);
+        m_cpts.append(md);
+    }
+
+    m_vsoils.reserve(snapshot.vsoilCount());
+    for(int i=0; i<snapshot.vsoilCount(); i++){
+        const sSnapshotVSoil &r = snapshot.vsoil(i);
+        sVSoilRecord *vs = m_vsoils.append(r.id);
+        vs->x = r.x;
+        vs->y = r.y;
+        vs->lat = r.latitude;
+        vs->lng = r.longitude;
+        vs->leveeLocation = r.leveeLocation;
+        vs->enabled = r.enabled != 0;
+        vs->source = intern(snapshot.string(r.source));
+        vs->name = snapshot.string(r.name);
+        const VSoilLayer *layers = snapshot.layers(r);
+        if(layers){
+            vs->layers.reserve(r.layerCount);
+            for(int j=0; j<r.layerCount; j++)
+                vs->layers.append(layers[j]);
+        }
+    }
+
+    updateVSoilIndex();
+    return true;
+}
+
+/*
+  Rebuilds the kd-tree of nearestVSoil on the enabled vsoils
+  */
+void EntityStore::updateVSoilIndex()
+{
+    QVector<sIndexPoint> points;
+    points.reserve(m_vsoils.count());
+    m_vsoilIndexSlots.clear();
+    m_vsoilIndexSlots.reserve(m_vsoils.count());
+    for(int slot=0; slot<m_vsoils.slotCount(); slot++){
+        const sVSoilRecord *vs = m_vsoils.atSlot(slot);
+        if(vs == NULL || !vs->enabled)
+            continue;
+        sIndexPoint p;
+        p.x = vs->x;
+        p.y = vs->y;
+        p.index = m_vsoilIndexSlots.count();
+        points.append(p);
+        m_vsoilIndexSlots.append(slot);
+    }
+    m_vsoilIndex.build(points);
+}
+
+/*
+  Returns the enabled vsoil closest to rd, NULL if there is none within
+  the distance (see updateVSoilIndex)
+  */
+const sVSoilRecord *EntityStore::nearestVSoil(QPointF rd, double maxDistanceSquared) const
+{
+    int index = m_vsoilIndex.nearest(rd, maxDistanceSquared);
+    if(index < 0)
+        return NULL;
+    return m_vsoils.atSlot(m_vsoilIndexSlots.at(index));
+}
+
+/*
+  The thickness weighted average of a soiltype parameter between zTop and
+  zBottom (zTop > zBottom) like DataStore::getAverage, parts outside of the
+  layers count as 0. Returns false if the range is invalid or a soiltype
+  is missing.
+  */
+bool EntityStore::average(const sVSoilRecord &vsoil, SoilType::Parameter parameter, double zTop, double zBottom, double &result) const
+{
+    result = 0.;
+    if(zTop <= zBottom)
+        return false;
+    double sum = 0.;
+    for(int i=0; i<vsoil.layers.count(); i++){
+        const VSoilLayer &sl = vsoil.layers.at(i);
+        double top = qMin(sl.zmax, zTop);
+        double bottom = qMax(sl.zmin, zBottom);
+        if(top <= bottom)
+            continue;
+        const sSoilTypeRecord *st = m_soilTypes.byId(sl.soiltype_id);
+        if(st == NULL){
+            qDebug() << "Error in EntityStore::average; no soiltype found with id =" << sl.soiltype_id;
+            return false;
+        }
+        sum += (top - bottom) * st->parameters[parameter];
+    }
+    result = sum / (zTop - zBottom);
+    return true;
+}
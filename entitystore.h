@@ -0,0 +1,179 @@
+#ifndef ENTITYSTORE_H
+#define ENTITYSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QBitArray>
+#include <QPointF>
+
+#include "cpt.h"
+#include "vsoil.h"
+#include "soiltype.h"
+#include "spatialindex.h"
+
+class SnapshotFile;
+
+/*
+    Keeps records of type T (see sVSoilRecord and sSoilTypeRecord) by id in
+    chunks of ChunkSize records. The records never move, so a pointer to a
+    record stays valid until the record is removed or the arena is cleared,
+    and records that were added together are next to each other in memory.
+    Removed slots are reused by the next insert.
+    Iterate over the records with slotCount / atSlot, free slots give NULL.
+    The loaders use append, which keeps records with an id that is already
+    used (the database does not enforce unique ids); byId returns the first
+    record with the id like the registries of DataStore, the others can only
+    be reached by slot.
+ */
+template<typename T>
+class EntityArena
+{
+public:
+    enum { ChunkSize = 1024 };
+
+    EntityArena() : m_count(0) {}
+    ~EntityArena() { clear(); }
+
+    //returns NULL if there already is a record with this id
+    T *insert(int id)
+    {
+        if(m_slotsById.contains(id))
+            return NULL;
+        return append(id);
+    }
+
+    //adds a record even if the id is used already, see above
+    T *append(int id)
+    {
+        int slot;
+        if(!m_freeSlots.isEmpty()){
+            slot = m_freeSlots.last();
+            m_freeSlots.removeLast();
+        }else{
+            slot = m_used.size();
+            if(slot == m_chunks.count() * ChunkSize)
+                m_chunks.append(new T[ChunkSize]);
+            m_used.resize(slot + 1);
+        }
+        m_used.setBit(slot);
+        if(!m_slotsById.contains(id))
+            m_slotsById.insert(id, slot);
+        m_count++;
+        T *record = recordAt(slot);
+        record->id = id;
+        return record;
+    }
+
+    bool remove(int id)
+    {
+        typename QHash<int, int>::iterator it = m_slotsById.find(id);
+        if(it == m_slotsById.end())
+            return false;
+        int slot = it.value();
+        m_slotsById.erase(it);
+        *recordAt(slot) = T(); //releases the strings and layers of the record
+        m_used.clearBit(slot);
+        m_freeSlots.append(slot);
+        m_count--;
+        return true;
+    }
+
+    void clear()
+    {
+        for(int i=0; i<m_chunks.count(); i++)
+            delete [] m_chunks[i];
+        m_chunks.clear();
+        m_used.clear();
+        m_freeSlots.clear();
+        m_slotsById.clear();
+        m_count = 0;
+    }
+
+    void reserve(int count)
+    {
+        m_slotsById.reserve(count);
+        while(m_chunks.count() * ChunkSize < count)
+            m_chunks.append(new T[ChunkSize]);
+    }
+
+    int count() const { return m_count; }
+    bool contains(int id) const { return m_slotsById.contains(id); }
+    T *byId(int id) const
+    {
+        typename QHash<int, int>::const_iterator it = m_slotsById.constFind(id);
+        return (it == m_slotsById.constEnd()) ? NULL : recordAt(it.value());
+    }
+
+    int slotCount() const { return m_used.size(); }
+    T *atSlot(int slot) const { return m_used.testBit(slot) ? recordAt(slot) : NULL; }
+
+private:
+    QVector<T*> m_chunks;      //ChunkSize records each
+    QBitArray m_used;          //per slot
+    QVector<int> m_freeSlots;
+    QHash<int, int> m_slotsById;
+    int m_count;
+
+    T *recordAt(int slot) const { return m_chunks.at(slot / ChunkSize) + (slot % ChunkSize); }
+
+    EntityArena(const EntityArena &);
+    EntityArena &operator=(const EntityArena &);
+};
+
+/*
+    The compact core of the model: cpt metadata, vsoils and soiltypes as
+    plain records without a QObject per item, for batch tools that do not
+    need the GUI. Loads straight from a database (on its own connection) or
+    from a snapshot (see SnapshotFile). Repeated strings (like the source of
+    a vsoil) share their data.
+    The GUI keeps using VSoil and SoilType, those can be put around the
+    records in the store (see VSoil(sVSoilRecord*)).
+    A store is not thread safe for writing, reading from several threads
+    is fine once it is loaded.
+ */
+class EntityStore
+{
+public:
+    EntityStore();
+    ~EntityStore();
+
+    bool loadFromDatabase(const QString &fileName, QStringList &log);
+    bool loadFromSnapshot(const SnapshotFile &snapshot, QStringList &log);
+    void clear();
+
+    const QVector<sCPTMetaData> &cpts() const { return m_cpts; }
+    EntityArena<sVSoilRecord> &vsoils() { return m_vsoils; }
+    const EntityArena<sVSoilRecord> &vsoils() const { return m_vsoils; }
+    EntityArena<sSoilTypeRecord> &soilTypes() { return m_soilTypes; }
+    const EntityArena<sSoilTypeRecord> &soilTypes() const { return m_soilTypes; }
+
+    //call updateVSoilIndex after adding, removing or moving vsoils
+    sVSoilRecord *addVSoil(int id) { return m_vsoils.insert(id); }
+    bool removeVSoil(int id) { return m_vsoils.remove(id); }
+    sVSoilRecord *vsoil(int id) const { return m_vsoils.byId(id); }
+    sSoilTypeRecord *addSoilType(int id) { return m_soilTypes.insert(id); }
+    sSoilTypeRecord *soilType(int id) const { return m_soilTypes.byId(id); }
+
+    QString intern(const QString &s);
+
+    void updateVSoilIndex();
+    const sVSoilRecord *nearestVSoil(QPointF rd, double maxDistanceSquared = 1e9) const;
+    bool average(const sVSoilRecord &vsoil, SoilType::Parameter parameter, double zTop, double zBottom, double &result) const;
+
+private:
+    QVector<sCPTMetaData> m_cpts;
+    EntityArena<sVSoilRecord> m_vsoils;
+    EntityArena<sSoilTypeRecord> m_soilTypes;
+    QSet<QString> m_strings; //see intern
+
+    SpatialIndex m_vsoilIndex; //kd-tree on the rd coordinates of the enabled vsoils
+    QVector<int> m_vsoilIndexSlots; //index in m_vsoilIndex -> slot in m_vsoils
+
+    EntityStore(const EntityStore &);
+    EntityStore &operator=(const EntityStore &);
+};
+
+#endif // ENTITYSTORE_H
@@ -0,0 +1,474 @@
+#include "gefparser.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QVarLengthArray>
+#include <QDebug>
+
+#include <cmath>
+#include <cstring>
+
+#include "latlon.h"
+
+#define MAXDATACOLUMNS 32
+
+/*
+    A piece of the (mapped) file running from begin up to (not including) end
+ */
+struct sByteRange{
+    const char *begin;
+    const char *end;
+};
+
+//exact powers of ten, used for the fast (correctly rounded) number conversion
+static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                               1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+                               1e20, 1e21, 1e22};
+
+static inline bool isSpace(char c)
+{
+    return (c==' ')||(c=='\t')||(c=='\r')||(c=='\n')||(c=='\v')||(c=='\f');
+}
+
+static inline bool isDigit(char c)
+{
+    return (c>='0')&&(c<='9');
+}
+
+static inline sByteRange makeRange(const char *begin, const char *end)
+{
+    sByteRange r;
+    r.begin = begin;
+    r.end = end;
+    return r;
+}
+
+static sByteRange trimmed(sByteRange r)
+{
+    while((r.begin < r.end) && isSpace(*r.begin)) r.begin++;
+    while((r.end > r.begin) && isSpace(*(r.end-1))) r.end--;
+    return r;
+}
+
+static inline int length(sByteRange r)
+{
+    return int(r.end - r.begin);
+}
+
+static inline const char *find(const char *begin, const char *end, char c)
+{
+    const char *p = static_cast<const char*>(memchr(begin, c, end - begin));
+    return (p==NULL) ? end : p;
+}
+
+static bool equals(sByteRange r, const char *s)
+{
+    size_t n = strlen(s);
+    return (size_t(r.end - r.begin) == n) && (memcmp(r.begin, s, n) == 0);
+}
+
+static bool contains(sByteRange r, const char *s)
+{
+    int n = int(strlen(s));
+    for(const char *p = r.begin; p + n <= r.end; p++){
+        if(memcmp(p, s, n) == 0)
+            return true;
+    }
+    return false;
+}
+
+//s is expected to be in uppercase
+static bool containsNoCase(sByteRange r, const char *s)
+{
+    int n = int(strlen(s));
+    for(const char *p = r.begin; p + n <= r.end; p++){
+        int i = 0;
+        while((i < n) && (((p[i] >= 'a') && (p[i] <= 'z')) ? (p[i] - 'a' + 'A') : p[i]) == s[i]) i++;
+        if(i == n)
+            return true;
+    }
+    return false;
+}
+
+static inline QString toQString(sByteRange r)
+{
+    return QString::fromLocal8Bit(r.begin, length(r));
+}
+
+/*
+    Splits r on the separator and stores at most maxParts ranges in parts.
+    If skipEmpty is set empty parts are dropped and the remaining parts are trimmed
+    (which is what the data rows need), otherwise the parts are stored as they are.
+    Returns the number of stored parts.
+ */
+static int split(sByteRange r, char separator, sByteRange *parts, int maxParts, bool skipEmpty)
+{
+    int n = 0;
+    const char *p = r.begin;
+    while(n < maxParts){
+        const char *sep = find(p, r.end, separator);
+        if(!skipEmpty){
+            parts[n++] = makeRange(p, sep);
+        }else if(sep > p){
+            parts[n++] = trimmed(makeRange(p, sep));
+        }
+        if(sep == r.end) break;
+        p = sep + 1;
+    }
+    return n;
+}
+
+/*
+    Same result as QString::toDouble on the given range but without creating
+    a string. Mantissas up to 2^53 combined with powers of ten up to 10^22 are
+    converted exactly, everything else is passed on to Qt.
+ */
+static bool toDouble(sByteRange r, double &value)
+{
+    value = 0.;
+    r = trimmed(r);
+    const char *p = r.begin;
+    const char *e = r.end;
+
+    bool negative = false;
+    if((p < e) && ((*p=='-')||(*p=='+'))){
+        negative = (*p=='-');
+        p++;
+    }
+
+    quint64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool anyDigit = false;
+    bool exact = true;
+
+    while((p < e) && isDigit(*p)){
+        anyDigit = true;
+        if(digits < 19){
+            mantissa = mantissa * 10 + quint64(*p - '0');
+            if(mantissa > 0) digits++;
+        }else{
+            exponent++;
+            exact = false;
+        }
+        p++;
+    }
+    if((p < e) && (*p=='.')){
+        p++;
+        while((p < e) && isDigit(*p)){
+            anyDigit = true;
+            if(digits < 19){
+                mantissa = mantissa * 10 + quint64(*p - '0');
+                if(mantissa > 0) digits++;
+                exponent--;
+            }else{
+                exact = false;
+            }
+            p++;
+        }
+    }
+    if(anyDigit && (p < e) && ((*p=='e')||(*p=='E'))){
+        p++;
+        bool negativeExponent = false;
+        if((p < e) && ((*p=='-')||(*p=='+'))){
+            negativeExponent = (*p=='-');
+            p++;
+        }
+        if((p < e) && isDigit(*p)){
+            int ev = 0;
+            while((p < e) && isDigit(*p)){
+                if(ev < 10000) ev = ev * 10 + (*p - '0');
+                p++;
+            }
+            exponent += negativeExponent ? -ev : ev;
+        }else{
+            exact = false;
+        }
+    }
+
+    if(anyDigit && exact && (p == e) && (mantissa <= (Q_UINT64_C(1) << 53)) && (exponent >= -22) && (exponent <= 22)){
+        double v = double(mantissa);
+        if(exponent < 0)
+            v /= POW10[-exponent];
+        else
+            v *= POW10[exponent];
+        value = negative ? -v : v;
+        return true;
+    }
+
+    //rare cases (inf, nan, very long or very large numbers, invalid input)
+    bool ok;
+    value = QByteArray::fromRawData(r.begin, length(r)).toDouble(&ok);
+    if(!ok) value = 0.;
+    return ok;
+}
+
+/*
+    Same result as QString::toInt on the given range, 0 if it is not a valid number
+ */
+static int toInt(sByteRange r)
+{
+    r = trimmed(r);
+    const char *p = r.begin;
+    bool negative = false;
+    if((p < r.end) && ((*p=='-')||(*p=='+'))){
+        negative = (*p=='-');
+        p++;
+    }
+    if((p == r.end) || (r.end - p > 9)){
+        return QByteArray::fromRawData(r.begin, length(r)).toInt();
+    }
+    int value = 0;
+    while(p < r.end){
+        if(!isDigit(*p))
+            return 0;
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    return negative ? -value : value;
+}
+
+GEFParser::GEFParser()
+{
+    m_bytesParsed = 0;
+    m_elapsedNSecs = 0;
+}
+
+/*
+    Returns the speed of the last parse in MB/s
+ */
+double GEFParser::throughput()
+{
+    if(m_elapsedNSecs <= 0)
+        return 0.;
+    return (double(m_bytesParsed) / (1024. * 1024.)) / (double(m_elapsedNSecs) / 1e9);
+}
+
+/*
+    Reads a CPT from a GEF file into the given metadata and columns.
+    The file is mapped into memory, if that is not possible it is read
+    into one buffer.
+*/
+bool GEFParser::parse(const QString &filename, sCPTMetaData &metaData, CPTSeries &series, QStringList &log)
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_bytesParsed = 0;
+    m_elapsedNSecs = 0;
+
+    QFile file(filename);
+    //try to open the file
+    if(!file.open(QIODevice::ReadOnly)) {
+        log.append(QString("ERROR in file %1: %2").arg(filename).arg(file.errorString()));
+        return false;
+    }
+
+    //extract the filename
+    QFileInfo fi(filename);
+    metaData.name = fi.fileName().split('.')[0];
+    metaData.fileName = file.fileName();
+
+    qint64 size = file.size();
+    const char *data = NULL;
+    uchar *mapped = NULL;
+    QByteArray buffer;
+    if(size > 0){
+        mapped = file.map(0, size);
+        if(mapped != NULL){
+            data = reinterpret_cast<const char*>(mapped);
+        }else{ //not mappable (pipes, some network shares), fall back to a single read
+            buffer = file.readAll();
+            data = buffer.constData();
+            size = buffer.size();
+        }
+    }
+
+    bool result = parseBuffer(data, size, filename, metaData, series, log);
+
+    if(mapped != NULL)
+        file.unmap(mapped);
+    file.close();
+
+    m_bytesParsed = size;
+    m_elapsedNSecs = timer.nsecsElapsed();
+    return result;
+}
+
+bool GEFParser::parseBuffer(const char *data, qint64 size, const QString &filename, sCPTMetaData &metaData,
+                            CPTSeries &series, QStringList &log)
+{
+    bool readHeader = true;
+    bool hasXY = false;
+    bool isCPT = false; //set if the report or procedure code is a CPT-REPORT
+    int colid[4] = {-1, -1, -1, -1}; //dz, qc, pw, wg
+    int colvoid[4] = {9999, 9999, 9999, 9999}; //dz, qc, pw, wg
+    char columnseperator = ' ';
+    int numColumns = 0; //number of data columns that we need to tokenize
+
+    sByteRange args[MAXDATACOLUMNS];
+    QVarLengthArray<sByteRange, MAXDATACOLUMNS> columns;
+    sByteRange empty = makeRange(data, data);
+
+    const char *pos = data;
+    const char *end = data + size;
+
+    while(pos < end) {
+        const char *eol = find(pos, end, '\n');
+        sByteRange line = makeRange(pos, eol);
+        pos = (eol < end) ? eol + 1 : end;
+        if((line.end > line.begin) && (*(line.end-1)=='\r')) line.end--;
+
+        if(readHeader){
+            //keyword= arg0, arg1, ...
+            const char *eq = find(line.begin, line.end, '=');
+            sByteRange keyword = trimmed(makeRange(line.begin, eq));
+            int nargs = 0;
+            if(eq < line.end)
+                nargs = split(makeRange(eq + 1, find(eq + 1, line.end, '=')), ',', args, MAXDATACOLUMNS, false);
+            for(int i=nargs; i<MAXDATACOLUMNS; i++)
+                args[i] = empty;
+
+            if (contains(line, "#EOH")){
+                //als er geen qc en pw is zijn we niet geinteresseerd in de sondering
+                if ((colid[1]==-1) || (colid[2]==-1)){
+                    log.append(QString("ERROR in file %1: Found gef file without qc or fs.").arg(filename));
+                    return false;
+                }
+                if (colid[0]==-1){
+                    log.append(QString("ERROR in file %1: Found gef file without columninfo for z.").arg(filename));
+                    return false;
+                }
+                //we only need to tokenize the data up to the last column of interest
+                for(int i=0; i<4; i++)
+                    if(colid[i] + 1 > numColumns) numColumns = colid[i] + 1;
+                columns.resize(numColumns);
+                //stop met de header en start het lezen van de data
+                readHeader = false;
+            }else if (equals(keyword, "#STARTDATE")){
+                int year = toInt(args[0]);
+                int month = toInt(args[1]);
+                int day = toInt(args[2]);
+                metaData.date = QDateTime(QDate(year, month, day));
+
+            }else if (equals(keyword, "#FILEDATE")){ //some people skip the startdate which is stupid but the filedate will do in this case
+                if (metaData.date.date().year() == 1900){
+                    int year = toInt(args[0]);
+                    int month = toInt(args[1]);
+                    int day = toInt(args[2]);
+                    metaData.date = QDateTime(QDate(year, month, day));
+                }
+            }else if (equals(keyword, "#LASTSCAN")){ //number of rows, saves growing the series
+                int lastScan = toInt(args[0]);
+                if ((lastScan > 0) && (lastScan <= size)) //every row takes more than one byte
+                    series.reserve(series.count() + lastScan);
+            }else if (equals(keyword, "#COLUMNSEPARATOR")){
+                sByteRange cs = trimmed(args[0]);
+                if (length(cs)>0)
+                    columnseperator = *cs.begin;
+            }else if (equals(keyword, "#REPORTCODE")||equals(keyword, "#PROCEDURECODE")){
+                if (containsNoCase(line, "CPT-REPORT")){
+                    isCPT = true;
+                }
+            }else if (equals(keyword, "#ZID")){
+                if (!toDouble(args[1], metaData.zmax)){
+                    log.append(QString("ERROR in file %1: Invalid X coord: %2").arg(filename).arg(toQString(args[1])));
+                    return false;
+                }
+            }else if (equals(keyword, "#XYID")){
+                if (!toDouble(args[1], metaData.x)){
+                    log.append(QString("ERROR in file %1: Invalid X coord: %2").arg(filename).arg(toQString(args[1])));
+                    return false;
+                }
+                if (!toDouble(args[2], metaData.y)) {
+                    log.append(QString("ERROR in file %1: Invalid Y coord: %2").arg(filename).arg(toQString(args[1])));
+                    return false;
+                }
+                //calculate the latitude and longitude from the rdcoords
+                LatLon ll;
+                ll.fromRDCoords(metaData.x, metaData.y);
+                metaData.latitude = ll.getLatitude();
+                metaData.longitude = ll.getLongitude();
+                hasXY = true;
+            }else if (equals(keyword, "#COLUMNVOID")){
+                /*
+                    ga er van uit dat altijd eerst columninfo wordt ingevuld en daarna columnvoid
+                    zo niet dan is er programmeerwerk nodig!
+                */
+                if (colid[1]==-1){
+                    log.append(QString("ERROR in file %1: Found gef file with columnvoid defined before columninfo").arg(filename));
+                    return false;
+                }
+                int id = toInt(args[0]);
+                for(int i=0; i<4; i++){
+                    if(colid[i] == id){
+                        double value;
+                        toDouble(args[1], value);
+                        colvoid[i] = static_cast<int>(value);
+                        //TODO: wat als het geen int is.. hypothetisch misschien maar toch
+                    }
+                }
+            }else if (equals(keyword, "#COLUMNINFO")){
+                int id = toInt(args[3]);
+                if((id==1)||(id==11)){ //sondeerlengte of gecorrigeerde sondeerlengte
+                    colid[0] = toInt(args[0]) - 1;
+                }else if(id == 2){ //conusweerstand
+                    colid[1] = toInt(args[0]) - 1;
+                }else if(id == 3){ //wrijvingsweerstand
+                    colid[2] = toInt(args[0]) - 1;
+                }else if(id == 4){ //wrijvingsgetal
+                    colid[3] = toInt(args[0]) - 1;
+                }
+            }
+        }else{ //read data
+            if (!isCPT){
+                log.append(QString("ERROR in file %1: Not of type CPT").arg(filename));
+                return false;
+            }
+            else if(!hasXY){
+                log.append(QString("ERROR in file %1: No coordinates found (#XYID)").arg(filename));
+                return false;
+            }
+            else{
+                //empty arguments are skipped, the others are trimmed
+                int n = split(line, columnseperator, columns.data(), numColumns, true);
+                for(int i=n; i<numColumns; i++)
+                    columns[i] = empty;
+
+                double vqc, vpw;
+                if (!toDouble(columns[colid[1]], vqc)){
+                    log.append(QString("ERROR in file %1: Invalid qc value: %2").arg(filename).arg(toQString(columns[colid[1]])));
+                    return false;
+                }
+                if (!toDouble(columns[colid[2]], vpw)){
+                    log.append(QString("ERROR in file %1: Invalid qc value: %2").arg(filename).arg(toQString(columns[colid[1]])));
+                    return false;
+                }
+                if((int(vqc)!=colvoid[1]) && (int(vpw)!=colvoid[2])){
+                    double dz;
+                    if (!toDouble(columns[colid[0]], dz)){
+                        log.append(QString("ERROR in file %1: Invalid dz value: %2").arg(filename).arg(toQString(columns[colid[1]])));
+                        return false;
+                    }
+
+                    if(vqc <= 0.)
+                        vqc = 0.01;
+                    double vwg;
+                    if(colid[3]==-1){
+                        vwg = (vpw / vqc) * 100.;
+                    }else{
+                        toDouble(columns[colid[3]], vwg);
+                    }
+                    series.append(metaData.zmax - std::abs(dz), vqc, vpw, vwg);
+                }
+            }
+        }
+    }
+    if(series.count()==0){
+        log.append(QString("ERROR in file %1: No data found.").arg(filename));
+        return false;
+    }
+    metaData.zmin = series.z().last();
+    return true;
+}
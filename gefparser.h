@@ -0,0 +1,36 @@
+#ifndef GEFPARSER_H
+#define GEFPARSER_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+#include "cpt.h"
+#include "cptseries.h"
+
+/*
+    Reads GEF (cpt) files without building a QString for every line or value.
+    The file is memory mapped and the header keywords and data columns are
+    tokenized in place as byte ranges. Numbers are converted straight from
+    these ranges so the only allocations left are the resulting columns.
+ */
+class GEFParser
+{
+public:
+    explicit GEFParser();
+
+    bool parse(const QString &filename, sCPTMetaData &metaData, CPTSeries &series, QStringList &log);
+
+    qint64 bytesParsed() { return m_bytesParsed; }
+    qint64 elapsedNSecs() { return m_elapsedNSecs; }
+    double throughput(); //MB/s of the last call to parse
+
+private:
+    bool parseBuffer(const char *data, qint64 size, const QString &filename, sCPTMetaData &metaData,
+                     CPTSeries &series, QStringList &log);
+
+    qint64 m_bytesParsed;
+    qint64 m_elapsedNSecs;
+};
+
+#endif // GEFPARSER_H
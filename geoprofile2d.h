@@ -3,14 +3,15 @@
 
 #include <QObject>
 #include <QList>
+#include <QVector>
 #include <QPointF>
 
 #include "vsoil.h"
 #include "soiltype.h"
 
 struct sArea{
-    int start;
-    int end;
+    double start; //[m] along the profile
+    double end;   //[m] along the profile
     int vsoilId;
 };
 
@@ -21,9 +22,9 @@ public:
     explicit GeoProfile2D(QObject *parent = 0);
     ~GeoProfile2D();
 
-    QList<sArea> *areas() { return m_areas; }
-    QList<QPointF> *points() { return m_points; }
-    QList<int> *soilTypeIDs() { return m_soilTypeIds; }
+    QVector<sArea> *areas() { return &m_areas; }
+    QVector<QPointF> *points() { return &m_points; }
+    QList<int> *soilTypeIDs() { return &m_soilTypeIds; }
 
     double lMin() { return 0; }
     double lMax();
@@ -34,14 +35,15 @@ public:
     void setZMax(double zmax) { m_zmax = zmax; }
 
     void addSoilTypeIDs(VSoil *vs);
+    void addSoilTypeIDs(const QList<int> &soilTypeIds);
 
     void getUniqueVSoilsIDs(QList<int> &vsoilIds);
     void optimize(); //avoids two or more consecutive areas with the same id
 
 private:
-    QList<sArea> *m_areas;
-    QList<QPointF> *m_points;
-    QList<int> *m_soilTypeIds;
+    QVector<sArea> m_areas;
+    QVector<QPointF> m_points;
+    QList<int> m_soilTypeIds;
     double m_zmin;    
     double m_zmax;
     
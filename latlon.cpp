@@ -1,9 +1,62 @@
 #include "latlon.h"
-#include "math.h"
+
+/*
+    The RD <-> WGS84 polynomials (Schreutelkamp & Strang van Hees). The
+    coefficients are stored per power of the first variable (the rows) with
+    the powers of the second variable in the columns, so every row is one
+    polynomial that is evaluated in Horner form.
+ */
+static const double RD_X0 = 155000.;
+static const double RD_Y0 = 463000.;
+static const double PHI0 = 52.15517440;
+static const double LAMBDA0 = 5.38720621;
+
+//x and y from dphi (rows) and dlambda (columns)
+static const double R[4][5] = {{0., 190094.945, -0.008, -32.391, 0.},
+                               {-0.705, -11832.228, 0., -0.608, 0.},
+                               {0., -114.211, 0., 0.148, 0.},
+                               {0., -2.340, 0., 0., 0.}};
+static const double S[4][5] = {{0., 0.433, 3638.893, 0., 0.092},
+                               {309056.544, -0.032, -157.984, 0., -0.054},
+                               {73.077, 0., -6.439, 0., 0.},
+                               {59.788, 0., 0., 0., 0.}};
+
+//phi and lambda from dx (rows) and dy (columns)
+static const double K[6][5] = {{0., 3235.65389, -.24750, -.06550, 0.},
+                               {-.00738, -.00012, 0., 0., 0.},
+                               {-32.58297, -.84978, -.01709, -.00039, 0.},
+                               {0., 0., 0., 0., 0.},
+                               {.00530, 0.00033, 0., 0., 0.},
+                               {0., 0., 0., 0., 0.}};
+static const double L[6][5] = {{0., .01199, 0.00022, 0., 0.},
+                               {5260.52916, 105.94684, 2.45656, .05594, .00128},
+                               {-.00022, 0., 0., 0., 0.},
+                               {-.81885, -.05607, -.00256, 0., 0.},
+                               {0., 0., 0., 0., 0.},
+                               {.00026, 0., 0., 0., 0.}};
+
+/*
+    sum(c[p][q] * a^p * b^q) in Horner form, the sizes are known at compile
+    time so the loops are unrolled and a loop over points calling this
+    vectorizes
+ */
+template <int P, int Q>
+static inline double horner2D(const double (&c)[P][Q], double a, double b)
+{
+    double result = 0.;
+    for(int p=P-1; p>=0; p--){
+        double row = 0.;
+        for(int q=Q-1; q>=0; q--)
+            row = row * b + c[p][q];
+        result = result * a + row;
+    }
+    return result;
+}
 
 LatLon::LatLon()
 {
-    LatLon(0., 0.);
+    m_longitude = 0.;
+    m_latitude = 0.;
 }
 
 LatLon::LatLon(double lat, double lon)
@@ -23,36 +76,9 @@ LatLon::LatLon(QPointF p)
  */
 QPointF LatLon::asRDCoords()
 {
-    double x0 = 155000.;
-    double y0 = 463000.;
-    double phi0 = 52.15517440;
-    double lambda0 = 5.38720621;
-
-    double R[4][5] = {{0., 190094.945, -0.008, -32.391, 0.},
-                      {-0.705, -11832.228, 0., -0.608, 0.},
-                      {0., -114.211, 0., 0.148, 0.},
-                      {0., -2.340, 0., 0., 0.}};
-    double S[4][5] = {{0., 0.433, 3638.893, 0., 0.092},
-                      {309056.544, -0.032, -157.984, 0., -0.054},
-                      {73.077, 0., -6.439, 0., 0.},
-                      {59.788, 0., 0., 0., 0.}};
-
-    double dphi = 0.36 * (m_latitude - phi0);
-    double dlambda = 0.36 * (m_longitude - lambda0);
-
-    double x = 0.;
-    double y = 0.;
-
-    for (int q=0; q<5; q++){
-        for (int p=0; p<4; p++){
-            x += R[p][q] * pow(dphi, float(p)) * pow(dlambda, float(q));
-            y += S[p][q] * pow(dphi, float(p)) * pow(dlambda, float(q));
-        }
-    }
-
-    x += x0;
-    y += y0;
-    return QPoint(x, y);
+    double x, y;
+    toRD(&m_latitude, &m_longitude, &x, &y, 1);
+    return QPointF(x, y);
 }
 
 /*
@@ -60,38 +86,83 @@ QPointF LatLon::asRDCoords()
  */
 void LatLon::fromRDCoords(double x, double y)
 {
-    double x0 = 155000.;
-    double y0 = 463000.;
-    double phi0 = 52.15517440;
-    double lambda0 = 5.38720621;
-
-    double K[6][5] = {{0., 3235.65389, -.24750, -.06550, 0.},
-                      {-.00738, -.00012, 0., 0., 0.},
-                      {-32.58297, -.84978, -.01709, -.00039, 0.},
-                      {0., 0., 0., 0., 0.},
-                      {.00530, 0.00033, 0., 0., 0.},
-                      {0., 0., 0., 0., 0.}};
-    double L[6][5] = {{0., .01199, 0.00022, 0., 0.},
-                      {5260.52916, 105.94684, 2.45656, .05594, .00128},
-                      {-.00022, 0., 0., 0., 0.},
-                      {-.81885, -.05607, -.00256, 0., 0.},
-                      {0., 0., 0., 0., 0.},
-                      {.00026, 0., 0., 0., 0.}};
-
-    double dx = (x - x0) * .00001;
-    double dy = (y - y0) * .00001;
-
-    double phi = 0.;
-    double lam = 0.;
-
-    for(int q=0; q<5; q++){
-        for (int p=0; p<6; p++){
-            phi += K[p][q] * pow(dx, float(p)) * pow(dy, float(q));
-            lam += L[p][q] * pow(dx, float(p)) * pow(dy, float(q));
-        }
+    fromRD(&x, &y, &m_latitude, &m_longitude, 1);
+}
+
+/*
+    Converts count latitude / longitude pairs into RD coordinates
+ */
+void LatLon::toRD(const double *latitudes, const double *longitudes, double *xs, double *ys, int count)
+{
+    for(int i=0; i<count; i++){
+        double dphi = 0.36 * (latitudes[i] - PHI0);
+        double dlambda = 0.36 * (longitudes[i] - LAMBDA0);
+        xs[i] = RD_X0 + horner2D(R, dphi, dlambda);
+        ys[i] = RD_Y0 + horner2D(S, dphi, dlambda);
+    }
+}
+
+/*
+    Converts count RD coordinates into latitude / longitude pairs
+ */
+void LatLon::fromRD(const double *xs, const double *ys, double *latitudes, double *longitudes, int count)
+{
+    for(int i=0; i<count; i++){
+        double dx = (xs[i] - RD_X0) * .00001;
+        double dy = (ys[i] - RD_Y0) * .00001;
+        latitudes[i] = PHI0 + horner2D(K, dx, dy) / 3600.;
+        longitudes[i] = LAMBDA0 + horner2D(L, dx, dy) / 3600.;
     }
+}
 
-    m_latitude = phi0 + phi / 3600.;
-    m_longitude = lambda0 + lam / 3600.;
+/*
+    QPointF is two doubles (x, y) so the points can be handled as interleaved
+    arrays, for latlon points x is the longitude and y the latitude
+ */
+void LatLon::toRD(const QPointF *latlonPoints, QPointF *rdPoints, int count)
+{
+    for(int i=0; i<count; i++){
+        double dphi = 0.36 * (latlonPoints[i].y() - PHI0);
+        double dlambda = 0.36 * (latlonPoints[i].x() - LAMBDA0);
+        rdPoints[i] = QPointF(RD_X0 + horner2D(R, dphi, dlambda), RD_Y0 + horner2D(S, dphi, dlambda));
+    }
 }
 
+void LatLon::fromRD(const QPointF *rdPoints, QPointF *latlonPoints, int count)
+{
+    for(int i=0; i<count; i++){
+        double dx = (rdPoints[i].x() - RD_X0) * .00001;
+        double dy = (rdPoints[i].y() - RD_Y0) * .00001;
+        latlonPoints[i] = QPointF(LAMBDA0 + horner2D(L, dx, dy) / 3600., PHI0 + horner2D(K, dx, dy) / 3600.);
+    }
+}
+
+QVector<QPointF> LatLon::toRD(const QVector<QPointF> &latlonPoints)
+{
+    QVector<QPointF> result(latlonPoints.count());
+    toRD(latlonPoints.constData(), result.data(), latlonPoints.count());
+    return result;
+}
+
+QVector<QPointF> LatLon::fromRD(const QVector<QPointF> &rdPoints)
+{
+    QVector<QPointF> result(rdPoints.count());
+    fromRD(rdPoints.constData(), result.data(), rdPoints.count());
+    return result;
+}
+
+ProjectedPolyline ProjectedPolyline::fromLatLon(const QList<QPointF> &latlonPoints)
+{
+    ProjectedPolyline polyline;
+    polyline.m_latlon = latlonPoints.toVector();
+    polyline.m_rd = LatLon::toRD(polyline.m_latlon);
+    return polyline;
+}
+
+ProjectedPolyline ProjectedPolyline::fromRD(const QList<QPointF> &rdPoints)
+{
+    ProjectedPolyline polyline;
+    polyline.m_rd = rdPoints.toVector();
+    polyline.m_latlon = LatLon::fromRD(polyline.m_rd);
+    return polyline;
+}
@@ -2,6 +2,8 @@
 #define LATLON_H
 
 #include <QPointF>
+#include <QVector>
+#include <QList>
 
 class LatLon
 {
@@ -18,10 +20,41 @@ public:
     QPointF asRDCoords();
     void fromRDCoords(double x, double y);
 
+    //batch conversions, points are (longitude, latitude) like LatLon(QPointF)
+    static void toRD(const double *latitudes, const double *longitudes, double *xs, double *ys, int count);
+    static void fromRD(const double *xs, const double *ys, double *latitudes, double *longitudes, int count);
+    static void toRD(const QPointF *latlonPoints, QPointF *rdPoints, int count);
+    static void fromRD(const QPointF *rdPoints, QPointF *latlonPoints, int count);
+    static QVector<QPointF> toRD(const QVector<QPointF> &latlonPoints);
+    static QVector<QPointF> fromRD(const QVector<QPointF> &rdPoints);
+
 private:
     double m_longitude;
     double m_latitude;
     
 };
 
+/*
+    A polyline in both projections, the vertices are converted once when the
+    polyline is made so the users do not have to convert them again.
+ */
+class ProjectedPolyline
+{
+public:
+    ProjectedPolyline() {}
+
+    static ProjectedPolyline fromLatLon(const QList<QPointF> &latlonPoints);
+    static ProjectedPolyline fromRD(const QList<QPointF> &rdPoints);
+
+    int count() const { return m_rd.count(); }
+    QPointF latlon(int i) const { return m_latlon.at(i); } //(longitude, latitude)
+    QPointF rd(int i) const { return m_rd.at(i); }
+    const QVector<QPointF> &latlonPoints() const { return m_latlon; }
+    const QVector<QPointF> &rdPoints() const { return m_rd; }
+
+private:
+    QVector<QPointF> m_latlon;
+    QVector<QPointF> m_rd;
+};
+
 #endif // LATLON_H
@@ -1,27 +1,44 @@
+# core of libbbgeo (model, database, import, geometry and export) on
+# QtCore and QtSql only, include libbbgeogui.pri for the table models and
+# dialogs
+QT += sql concurrent
+
 INCLUDEPATH += $${PWD}
 DEPENDPATH += $${PWD}
 
 SOURCES +=  cpt.cpp\
-            cpttablemodel.cpp\
+            cptseries.cpp\
             datastore.cpp\
+            datastoreloader.cpp\
             dbadapter.cpp\
+            entitystore.cpp\
+            gefparser.cpp\
             geoprofile2d.cpp\
             latlon.cpp\
-            soillayertablemodel.cpp\
+            snapshotfile.cpp\
+            soilclassifier.cpp\
             soiltype.cpp\
-            soiltypetablemodel.cpp\
-            vsoil.cpp
+            spatialindex.cpp\
+            vsoil.cpp\
+            vsoilsnapshot.cpp
 
 HEADERS +=  cpt.h\
-            cpttablemodel.h\
+            cptseries.h\
             datastore.h\
+            datastoreloader.h\
             dbadapter.h\
+            entitystore.h\
+            gefparser.h\
             geoprofile2d.h\
             latlon.h\
-            soillayertablemodel.h\
+            smallvector.h\
+            snapshotfile.h\
+            soilclassifier.h\
             soiltype.h\
-            soiltypetablemodel.h\
-            vsoil.h
+            spatialindex.h\
+            varint.h\
+            vsoil.h\
+            vsoilsnapshot.h
 
 
 
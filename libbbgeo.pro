@@ -4,7 +4,9 @@
 #
 #-------------------------------------------------
 
-QT       += network sql gui widgets
+# the core library only needs QtCore and QtSql so batch jobs can run
+# without a display, the table models and dialogs are in libbbgeogui.pro
+QT       = core sql concurrent
 
 TARGET = libbbgeo
 TEMPLATE = lib
@@ -13,28 +15,40 @@ DEFINES += LIBBBGEO_LIBRARY
 
 SOURCES += libbbgeo.cpp \
     vsoil.cpp \
-    soiltypetablemodel.cpp \
     soiltype.cpp \
-    soillayertablemodel.cpp \
     latlon.cpp \
     geoprofile2d.cpp \
     dbadapter.cpp \
+    entitystore.cpp \
     datastore.cpp \
-    cpttablemodel.cpp \
-    cpt.cpp
+    datastoreloader.cpp \
+    cpt.cpp \
+    cptseries.cpp \
+    gefparser.cpp \
+    soilclassifier.cpp \
+    snapshotfile.cpp \
+    spatialindex.cpp \
+    vsoilsnapshot.cpp
 
 HEADERS += libbbgeo.h\
         libbbgeo_global.h \
     vsoil.h \
-    soiltypetablemodel.h \
     soiltype.h \
-    soillayertablemodel.h \
     latlon.h \
     geoprofile2d.h \
     dbadapter.h \
+    entitystore.h \
     datastore.h \
-    cpttablemodel.h \
-    cpt.h
+    datastoreloader.h \
+    cpt.h \
+    cptseries.h \
+    gefparser.h \
+    smallvector.h \
+    soilclassifier.h \
+    snapshotfile.h \
+    spatialindex.h \
+    varint.h \
+    vsoilsnapshot.h
 
 symbian {
     MMP_RULES += EXPORTUNFROZEN
@@ -56,4 +70,5 @@ unix:!symbian {
 }
 
 OTHER_FILES += \
-    libbbgeo.pri
+    libbbgeo.pri \
+    libbbgeogui.pri
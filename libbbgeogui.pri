@@ -0,0 +1,15 @@
+# GUI add-on of libbbgeo, the table models and the dialogs for DataStore,
+# includes the core (libbbgeo.pri)
+include($${PWD}/libbbgeo.pri)
+
+QT += gui widgets
+
+SOURCES +=  cpttablemodel.cpp\
+            datastoredialogs.cpp\
+            soillayertablemodel.cpp\
+            soiltypetablemodel.cpp
+
+HEADERS +=  cpttablemodel.h\
+            datastoredialogs.h\
+            soillayertablemodel.h\
+            soiltypetablemodel.h
@@ -0,0 +1,34 @@
+#-------------------------------------------------
+#
+# GUI add-on of libbbgeo: the table models and the dialogs that show the
+# errors and progress of DataStore. Links against the core library
+# (libbbgeo.pro), build that first.
+#
+#-------------------------------------------------
+
+QT       = core sql concurrent gui widgets
+
+TARGET = libbbgeogui
+TEMPLATE = lib
+
+INCLUDEPATH += $$PWD
+LIBS += -L$$OUT_PWD -llibbbgeo
+
+SOURCES += cpttablemodel.cpp \
+    datastoredialogs.cpp \
+    soillayertablemodel.cpp \
+    soiltypetablemodel.cpp
+
+HEADERS += cpttablemodel.h \
+    datastoredialogs.h \
+    soillayertablemodel.h \
+    soiltypetablemodel.h
+
+unix:!symbian {
+    maemo5 {
+        target.path = /opt/usr/lib
+    } else {
+        target.path = /usr/lib
+    }
+    INSTALLS += target
+}
@@ -0,0 +1,106 @@
+#ifndef SMALLVECTOR_H
+#define SMALLVECTOR_H
+
+#include <QtGlobal>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+    A vector that keeps up to N items inside the object itself and only
+    allocates when it grows beyond that. Used for the layers of a vsoil so
+    a typical vsoil does not need a separate allocation for its layers.
+    The items are copied with memcpy, so T has to be a plain struct (like
+    VSoilLayer). The method names follow QList so code that worked on a
+    QList of layers keeps working.
+ */
+template<typename T, int N>
+class SmallVector
+{
+public:
+    SmallVector() : m_data(m_inline), m_count(0), m_capacity(N) {}
+    SmallVector(const SmallVector &other) : m_data(m_inline), m_count(0), m_capacity(N) { *this = other; }
+    ~SmallVector() { if(m_data != m_inline) free(m_data); }
+
+    SmallVector &operator=(const SmallVector &other)
+    {
+        if(this != &other){
+            m_count = 0;
+            reserve(other.m_count);
+            memcpy(m_data, other.m_data, sizeof(T) * other.m_count);
+            m_count = other.m_count;
+        }
+        return *this;
+    }
+
+    int count() const { return m_count; }
+    int size() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+    bool isInline() const { return m_data == m_inline; }
+
+    const T &at(int i) const { Q_ASSERT(i >= 0 && i < m_count); return m_data[i]; }
+    T &operator[](int i) { Q_ASSERT(i >= 0 && i < m_count); return m_data[i]; }
+    const T &operator[](int i) const { Q_ASSERT(i >= 0 && i < m_count); return m_data[i]; }
+    T &first() { return m_data[0]; }
+    const T &first() const { return m_data[0]; }
+    T &last() { return m_data[m_count - 1]; }
+    const T &last() const { return m_data[m_count - 1]; }
+
+    T *data() { return m_data; }
+    const T *constData() const { return m_data; }
+    T *begin() { return m_data; }
+    T *end() { return m_data + m_count; }
+    const T *begin() const { return m_data; }
+    const T *end() const { return m_data + m_count; }
+
+    void reserve(int capacity)
+    {
+        if(capacity <= m_capacity)
+            return;
+        T *data = static_cast<T*>(malloc(sizeof(T) * capacity));
+        Q_CHECK_PTR(data);
+        memcpy(data, m_data, sizeof(T) * m_count);
+        if(m_data != m_inline)
+            free(m_data);
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    void append(const T &t)
+    {
+        T copy = t; //t may be an item of this vector
+        if(m_count == m_capacity)
+            reserve(m_capacity * 2);
+        m_data[m_count++] = copy;
+    }
+
+    void insert(int i, const T &t)
+    {
+        Q_ASSERT(i >= 0 && i <= m_count);
+        T copy = t;
+        if(m_count == m_capacity)
+            reserve(m_capacity * 2);
+        memmove(m_data + i + 1, m_data + i, sizeof(T) * (m_count - i));
+        m_data[i] = copy;
+        m_count++;
+    }
+
+    void replace(int i, const T &t) { Q_ASSERT(i >= 0 && i < m_count); m_data[i] = t; }
+
+    void removeAt(int i)
+    {
+        Q_ASSERT(i >= 0 && i < m_count);
+        memmove(m_data + i, m_data + i + 1, sizeof(T) * (m_count - i - 1));
+        m_count--;
+    }
+
+    void removeLast() { Q_ASSERT(m_count > 0); m_count--; }
+    void clear() { m_count = 0; } //keeps the allocated capacity
+
+private:
+    T *m_data;     //m_inline or a heap block of m_capacity items
+    int m_count;
+    int m_capacity;
+    T m_inline[N];
+};
+
+#endif // SMALLVECTOR_H
@@ -0,0 +1,308 @@
+#include "snapshotfile.h"
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QDebug>
+#include <QtEndian>
+
+#include <cstring>
+
+struct sSnapshotHeader{
+    char magic[8];
+    quint32 version;
+    quint32 numSections;
+    qint64 dbSize;     //size of the database when the snapshot was written
+    qint64 dbModified; //modification time (msecs since epoch) of the database
+    qint64 walSize;    //size of the write ahead log of the database, 0 if there is none
+    quint32 dbChangeCounter; //file change counter in the sqlite header of the database
+    quint32 reserved;
+    sSnapshotSection sections[SnapshotFile::NumSections];
+};
+
+static const qint64 SNAPSHOT_RECORD_SIZES[SnapshotFile::NumSections] = {
+    1,                          //Strings
+    sizeof(sSnapshotSoilType),  //SoilTypes
+    sizeof(sSnapshotCPT),       //CPTs
+    sizeof(sSnapshotVSoil),     //VSoils
+    sizeof(VSoilLayer),         //Layers
+    sizeof(sIndexPoint),        //VSoilKdTree
+    sizeof(sIndexPoint),        //CPTViewPoints
+    sizeof(sRTreeNode),         //CPTViewNodes
+    sizeof(sIndexPoint),        //VSoilViewPoints
+    sizeof(sRTreeNode)          //VSoilViewNodes
+};
+
+/*
+  The state of the database that a snapshot belongs to. sqlite changes pages
+  in place so most updates keep the size and the modification time can be
+  too coarse, but every transaction increments the file change counter at
+  offset 24 of the database header (big endian).
+  */
+static void databaseState(const QString &dbFileName, qint64 &size, qint64 &modified, qint64 &walSize, quint32 &changeCounter)
+{
+    QFileInfo info(dbFileName);
+    size = info.size();
+    modified = info.lastModified().toMSecsSinceEpoch();
+    QFileInfo wal(dbFileName + "-wal");
+    walSize = wal.exists() ? wal.size() : 0;
+    changeCounter = 0;
+    QFile db(dbFileName);
+    uchar counter[4];
+    if(db.open(QIODevice::ReadOnly) && db.seek(24) && db.read(reinterpret_cast<char*>(counter), 4) == 4)
+        changeCounter = qFromBigEndian<quint32>(counter);
+}
+
+/*
+  Collects the strings of the records, see write
+  */
+static sSnapshotString addString(QByteArray &strings, const QString &s)
+{
+    QByteArray utf8 = s.toUtf8();
+    sSnapshotString result;
+    result.offset = quint32(strings.size());
+    result.length = quint32(utf8.size());
+    strings.append(utf8);
+    return result;
+}
+
+SnapshotFile::SnapshotFile()
+{
+    m_data = NULL;
+    m_size = 0;
+    memset(m_sections, 0, sizeof(m_sections));
+}
+
+SnapshotFile::~SnapshotFile()
+{
+    close();
+}
+
+/*
+  Writes a snapshot of the given data, the view indexes must be built on
+  the cpts and vsoils in the same order (see DataStore::updateViewIndexes).
+  The file is replaced at once so processes that have the old snapshot
+  mapped keep working with it.
+  */
+bool SnapshotFile::write(const QString &fileName, const QString &dbFileName,
+                         const QList<sCPTMetaData> &cpts, const QList<SoilType*> &soilTypes, const QList<VSoil*> &vsoils,
+                         const RTree &cptViewIndex, const RTree &vsoilViewIndex, QStringList &log)
+{
+    QByteArray strings;
+
+    QVector<sSnapshotSoilType> soilTypeRecords(soilTypes.count());
+    for(int i=0; i<soilTypes.count(); i++){
+        SoilType *st = soilTypes.at(i);
+        sSnapshotSoilType &r = soilTypeRecords[i];
+        memset(&r, 0, sizeof(r));
+        r.id = st->id();
+        for(int p=0; p<SNAPSHOT_NUM_PARAMETERS; p++)
+            r.parameters[p] = st->parameter(SoilType::Parameter(p));
+        r.name = addString(strings, st->name());
+        r.description = addString(strings, st->description());
+        r.source = addString(strings, st->source());
+        r.color = addString(strings, st->color());
+    }
+
+    QVector<sSnapshotCPT> cptRecords(cpts.count());
+    for(int i=0; i<cpts.count(); i++){
+        const sCPTMetaData &md = cpts.at(i);
+        sSnapshotCPT &r = cptRecords[i];
+        memset(&r, 0, sizeof(r));
+        r.id = md.id;
+        r.vsoilId = md.vsoilId;
+        r.x = md.x;
+        r.y = md.y;
+        r.latitude = md.latitude;
+        r.longitude = md.longitude;
+        r.zmax = md.zmax;
+        r.zmin = md.zmin;
+        r.date = md.date.toMSecsSinceEpoch();
+        r.fileName = addString(strings, md.fileName);
+        r.name = addString(strings, md.name);
+    }
+
+    QVector<sSnapshotVSoil> vsoilRecords(vsoils.count());
+    QVector<VSoilLayer> layers;
+    QVector<sIndexPoint> points(vsoils.count());
+    for(int i=0; i<vsoils.count(); i++){
+        VSoil *vs = vsoils.at(i);
+        sSnapshotVSoil &r = vsoilRecords[i];
+        memset(&r, 0, sizeof(r));
+        r.id = vs->id();
+        r.leveeLocation = vs->levee_location();
+        r.x = vs->x();
+        r.y = vs->y();
+        r.latitude = vs->latitude();
+        r.longitude = vs->longitude();
+        r.firstLayer = layers.count();
+        r.layerCount = vs->getSoilLayers()->count();
+        r.enabled = vs->isEnabled() ? 1 : 0;
+        r.source = addString(strings, vs->source());
+        r.name = addString(strings, vs->name());
+        for(int j=0; j<vs->getSoilLayers()->count(); j++)
+            layers.append(vs->getSoilLayers()->at(j));
+        points[i].x = vs->x();
+        points[i].y = vs->y();
+        points[i].index = i;
+    }
+    SpatialIndex vsoilIndex;
+    vsoilIndex.build(points);
+
+    //the sections in the order of Section
+    const void *data[NumSections] = {
+        strings.constData(), soilTypeRecords.constData(), cptRecords.constData(),
+        vsoilRecords.constData(), layers.constData(), vsoilIndex.points(),
+        cptViewIndex.points(), cptViewIndex.nodes(), vsoilViewIndex.points(), vsoilViewIndex.nodes()
+    };
+    const qint64 counts[NumSections] = {
+        strings.size(), soilTypeRecords.count(), cptRecords.count(),
+        vsoilRecords.count(), layers.count(), vsoilIndex.count(),
+        cptViewIndex.count(), cptViewIndex.nodeCount(), vsoilViewIndex.count(), vsoilViewIndex.nodeCount()
+    };
+
+    sSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+    header.version = SNAPSHOT_VERSION;
+    header.numSections = NumSections;
+    databaseState(dbFileName, header.dbSize, header.dbModified, header.walSize, header.dbChangeCounter);
+    qint64 offset = (sizeof(header) + 7) & ~qint64(7);
+    for(int s=0; s<NumSections; s++){
+        header.sections[s].offset = offset;
+        header.sections[s].count = counts[s];
+        header.sections[s].recordSize = SNAPSHOT_RECORD_SIZES[s];
+        offset = (offset + counts[s] * SNAPSHOT_RECORD_SIZES[s] + 7) & ~qint64(7);
+    }
+
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly)){
+        log.append(QString("Could not write the snapshot %1").arg(fileName));
+        return false;
+    }
+    static const char padding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    qint64 position = sizeof(header);
+    for(int s=0; s<NumSections; s++){
+        file.write(padding, header.sections[s].offset - position);
+        qint64 size = counts[s] * SNAPSHOT_RECORD_SIZES[s];
+        if(size > 0)
+            file.write(static_cast<const char*>(data[s]), size);
+        position = header.sections[s].offset + size;
+    }
+    file.write(padding, offset - position);
+    if(!file.commit()){
+        log.append(QString("Could not write the snapshot %1: %2").arg(fileName).arg(file.errorString()));
+        return false;
+    }
+    log.append(QString("Written snapshot %1 (%2 bytes)").arg(fileName).arg(offset));
+    return true;
+}
+
+/*
+  Returns true if the snapshot exists and was written from the current
+  state of the database
+  */
+bool SnapshotFile::isValidFor(const QString &fileName, const QString &dbFileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    sSnapshotHeader header;
+    if(file.read(reinterpret_cast<char*>(&header), sizeof(header)) != qint64(sizeof(header)))
+        return false;
+    qint64 size, modified, walSize;
+    quint32 changeCounter;
+    databaseState(dbFileName, size, modified, walSize, changeCounter);
+    return (memcmp(header.magic, SNAPSHOT_MAGIC, 8) == 0) && (header.version == SNAPSHOT_VERSION) &&
+           (header.dbSize == size) && (header.dbModified == modified) && (header.walSize == walSize) &&
+           (header.dbChangeCounter == changeCounter);
+}
+
+/*
+  Maps the snapshot, fails if it is not a valid snapshot or if the database
+  changed since it was written
+  */
+bool SnapshotFile::open(const QString &fileName, const QString &dbFileName, QStringList &log)
+{
+    close();
+    if(!isValidFor(fileName, dbFileName)){
+        log.append(QString("The snapshot %1 is missing or outdated").arg(fileName));
+        return false;
+    }
+    m_file.setFileName(fileName);
+    if(!m_file.open(QIODevice::ReadOnly)){
+        log.append(QString("Could not open the snapshot %1").arg(fileName));
+        return false;
+    }
+    m_size = m_file.size();
+    const uchar *data = m_file.map(0, m_size);
+    if(data == NULL){
+        log.append(QString("Could not map the snapshot %1").arg(fileName));
+        m_file.close();
+        return false;
+    }
+
+    //check the layout before anything is used
+    const sSnapshotHeader *header = reinterpret_cast<const sSnapshotHeader*>(data);
+    bool ok = (m_size >= qint64(sizeof(sSnapshotHeader))) && (header->numSections == NumSections);
+    for(int s=0; ok && s<NumSections; s++){
+        const sSnapshotSection &section = header->sections[s];
+        ok = (section.recordSize == SNAPSHOT_RECORD_SIZES[s]) && (section.offset % 8 == 0) &&
+             (section.count >= 0) && (section.offset >= qint64(sizeof(sSnapshotHeader))) &&
+             (section.offset + section.count * section.recordSize <= m_size);
+    }
+    if(!ok){
+        log.append(QString("The snapshot %1 is damaged").arg(fileName));
+        m_file.unmap(const_cast<uchar*>(data));
+        m_file.close();
+        return false;
+    }
+    m_data = data;
+    memcpy(m_sections, header->sections, sizeof(m_sections));
+    m_vsoilIndex.attach(static_cast<const sIndexPoint*>(section(VSoilKdTree)), int(m_sections[VSoilKdTree].count));
+    return true;
+}
+
+void SnapshotFile::close()
+{
+    m_vsoilIndex.clear();
+    if(m_data){
+        m_file.unmap(const_cast<uchar*>(m_data));
+        m_data = NULL;
+    }
+    if(m_file.isOpen())
+        m_file.close();
+    m_size = 0;
+    memset(m_sections, 0, sizeof(m_sections));
+}
+
+/*
+  Returns the layers of the vsoil (vsoil.layerCount), NULL if they are not
+  within the file
+  */
+const VSoilLayer *SnapshotFile::layers(const sSnapshotVSoil &vsoil) const
+{
+    if(vsoil.firstLayer < 0 || vsoil.layerCount < 0 || vsoil.firstLayer + qint64(vsoil.layerCount) > m_sections[Layers].count)
+        return NULL;
+    return static_cast<const VSoilLayer*>(section(Layers)) + vsoil.firstLayer;
+}
+
+QString SnapshotFile::string(const sSnapshotString &s) const
+{
+    if(qint64(s.offset) + s.length > m_sections[Strings].count)
+        return QString();
+    return QString::fromUtf8(static_cast<const char*>(section(Strings)) + s.offset, s.length);
+}
+
+/*
+  Lets the r-trees use the mapped view indexes, they stay valid while the
+  snapshot is open
+  */
+void SnapshotFile::attachViewIndexes(RTree &cptViewIndex, RTree &vsoilViewIndex) const
+{
+    cptViewIndex.attach(static_cast<const sIndexPoint*>(section(CPTViewPoints)), int(m_sections[CPTViewPoints].count),
+                        static_cast<const sRTreeNode*>(section(CPTViewNodes)), int(m_sections[CPTViewNodes].count));
+    vsoilViewIndex.attach(static_cast<const sIndexPoint*>(section(VSoilViewPoints)), int(m_sections[VSoilViewPoints].count),
+                          static_cast<const sRTreeNode*>(section(VSoilViewNodes)), int(m_sections[VSoilViewNodes].count));
+}
@@ -0,0 +1,133 @@
+#ifndef SNAPSHOTFILE_H
+#define SNAPSHOTFILE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QFile>
+
+#include "cpt.h"
+#include "vsoil.h"
+#include "soiltype.h"
+#include "spatialindex.h"
+
+/*
+    Layout of the snapshot file, all sections are arrays of the records
+    below and start on an 8 byte boundary so the mapped file can be used as
+    is. Numbers are stored in the byte order of the machine that wrote the
+    file; a snapshot is a cache for one host, not an exchange format.
+ */
+#define SNAPSHOT_MAGIC "BBGEOSNP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_NUM_PARAMETERS (SoilType::Cv + 1)
+
+struct sSnapshotString{
+    quint32 offset; //in the strings section, utf-8
+    quint32 length;
+};
+
+struct sSnapshotSoilType{
+    qint32 id;
+    qint32 reserved;
+    double parameters[SNAPSHOT_NUM_PARAMETERS]; //by SoilType::Parameter
+    sSnapshotString name;
+    sSnapshotString description;
+    sSnapshotString source;
+    sSnapshotString color;
+};
+
+struct sSnapshotCPT{
+    qint32 id;
+    qint32 vsoilId;
+    double x;
+    double y;
+    double latitude;
+    double longitude;
+    double zmax;
+    double zmin;
+    qint64 date; //msecs since epoch
+    sSnapshotString fileName;
+    sSnapshotString name;
+};
+
+struct sSnapshotVSoil{
+    qint32 id;
+    qint32 leveeLocation;
+    double x;
+    double y;
+    double latitude;
+    double longitude;
+    qint32 firstLayer; //in the layers section
+    qint32 layerCount;
+    qint32 enabled;
+    qint32 reserved;
+    sSnapshotString source;
+    sSnapshotString name;
+};
+
+struct sSnapshotSection{
+    qint64 offset; //from the start of the file
+    qint64 count;  //number of records
+    qint64 recordSize;
+};
+
+/*
+    A read-only, memory mapped copy of a loaded datastore: the cpt metadata,
+    the vsoils with their layers, the soiltypes and the spatial indexes
+    (a kd-tree on the rd coordinates of the vsoils and the r-trees on the
+    latitude / longitude of the cpts and vsoils that DataStore uses for the
+    viewport). The records are used straight from the mapping, nothing is
+    parsed when the file is opened.
+    The file remembers the size, the modification time and the file change
+    counter of the database it was written from and refuses to open if the
+    database changed since.
+    The file is mapped read-only and shared, so processes on one host that
+    open the same snapshot share its pages.
+ */
+class SnapshotFile
+{
+public:
+    enum Section {
+        Strings, SoilTypes, CPTs, VSoils, Layers, VSoilKdTree,
+        CPTViewPoints, CPTViewNodes, VSoilViewPoints, VSoilViewNodes,
+        NumSections
+    };
+
+    SnapshotFile();
+    ~SnapshotFile();
+
+    static bool write(const QString &fileName, const QString &dbFileName,
+                      const QList<sCPTMetaData> &cpts, const QList<SoilType*> &soilTypes, const QList<VSoil*> &vsoils,
+                      const RTree &cptViewIndex, const RTree &vsoilViewIndex, QStringList &log);
+    static bool isValidFor(const QString &fileName, const QString &dbFileName);
+
+    bool open(const QString &fileName, const QString &dbFileName, QStringList &log);
+    void close();
+    bool isOpen() const { return m_data != NULL; }
+
+    int soilTypeCount() const { return int(m_sections[SoilTypes].count); }
+    const sSnapshotSoilType &soilType(int i) const { return soilTypeRecords()[i]; }
+    int cptCount() const { return int(m_sections[CPTs].count); }
+    const sSnapshotCPT &cpt(int i) const { return cptRecords()[i]; }
+    int vsoilCount() const { return int(m_sections[VSoils].count); }
+    const sSnapshotVSoil &vsoil(int i) const { return vsoilRecords()[i]; }
+    const VSoilLayer *layers(const sSnapshotVSoil &vsoil) const;
+    QString string(const sSnapshotString &s) const;
+
+    int nearestVSoil(QPointF rd, double maxDistanceSquared = 1e9) const { return m_vsoilIndex.nearest(rd, maxDistanceSquared); }
+    void attachViewIndexes(RTree &cptViewIndex, RTree &vsoilViewIndex) const;
+
+private:
+    QFile m_file;
+    const uchar *m_data;
+    qint64 m_size;
+    sSnapshotSection m_sections[NumSections];
+    SpatialIndex m_vsoilIndex; //attached to the VSoilKdTree section
+
+    const void *section(Section s) const { return m_data + m_sections[s].offset; }
+    const sSnapshotSoilType *soilTypeRecords() const { return static_cast<const sSnapshotSoilType*>(section(SoilTypes)); }
+    const sSnapshotCPT *cptRecords() const { return static_cast<const sSnapshotCPT*>(section(CPTs)); }
+    const sSnapshotVSoil *vsoilRecords() const { return static_cast<const sSnapshotVSoil*>(section(VSoils)); }
+};
+
+#endif // SNAPSHOTFILE_H
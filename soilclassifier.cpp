@@ -0,0 +1,263 @@
+#include "soilclassifier.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <QHash>
+#include <QDebug>
+
+#include <cmath>
+
+/*
+    Classifies the values and translates the classes into soiltype ids
+ */
+void SoilClassifier::classifyToSoilTypeIds(const double *qc, const double *rf, int count, int *soilTypeIds) const
+{
+    if(m_soilTypeIds.isEmpty()){
+        for(int i=0; i<count; i++)
+            soilTypeIds[i] = -1;
+        return;
+    }
+    classify(qc, rf, count, soilTypeIds);
+    const int *ids = m_soilTypeIds.constData();
+    for(int i=0; i<count; i++)
+        soilTypeIds[i] = ids[soilTypeIds[i]];
+}
+
+/*
+    Looks up the soiltype for every class by name (case insensitive, the
+    first soiltype with the name wins) if mapByName is set. Classes without
+    a soiltype get their default id and are reported in the log. Returns the
+    number of classes that are mapped on a soiltype by name.
+ */
+int SoilClassifier::mapToSoilTypes(const QList<SoilType*> &soilTypes, QStringList &log)
+{
+    if(!m_mapByName){
+        m_soilTypeIds = m_defaultSoilTypeIds;
+        return 0;
+    }
+
+    QHash<QString, int> idsByName;
+    for(int i=soilTypes.count()-1; i>=0; i--)
+        idsByName.insert(soilTypes.at(i)->name().trimmed().toLower(), soilTypes.at(i)->id());
+
+    int numMapped = 0;
+    for(int c=0; c<m_classNames.count(); c++){
+        QString key = m_classNames.at(c).trimmed().toLower();
+        if(idsByName.contains(key)){
+            m_soilTypeIds[c] = idsByName.value(key);
+            numMapped++;
+        }else{
+            m_soilTypeIds[c] = m_defaultSoilTypeIds.at(c);
+            log.append(QString("%1: no soiltype named '%2', using id %3").arg(name()).arg(m_classNames.at(c)).arg(m_soilTypeIds.at(c)));
+        }
+    }
+    return numMapped;
+}
+
+void SoilClassifier::setClasses(const QStringList &names, const QList<int> &defaultSoilTypeIds)
+{
+    m_classNames = names;
+    m_defaultSoilTypeIds = defaultSoilTypeIds.toVector();
+    m_soilTypeIds = m_defaultSoilTypeIds;
+}
+
+/*
+    CUR162 upper limits of the classes, the last class has no upper limit
+ */
+static const int CUR162_NUM_LIMITS = 9;
+static const double CUR162_LIMITS[CUR162_NUM_LIMITS] = {0.6, 0.8, 1.1, 1.4, 1.8, 2.2, 2.5, 5.0, 8.1};
+
+CUR162Classifier::CUR162Classifier()
+{
+    QStringList names;
+    names << "zand grof" << "zand middelgrof" << "zand fijn" << "zand siltig" << "zand kleiig"
+          << "leem" << "klei zandig" << "klei" << "klei humeus" << "veen";
+    QList<int> ids;
+    for(int i=0; i<names.count(); i++)
+        ids.append(10000 + i); //the ids that were hard coded before the classifiers
+    setClasses(names, ids);
+}
+
+/*
+    The class is the number of limits below rf, counted without branches so
+    the loop vectorizes. A NaN rf ends up in the last class, like the if-chain
+    this replaces.
+ */
+void CUR162Classifier::classify(const double *qc, const double *rf, int count, int *classes) const
+{
+    Q_UNUSED(qc);
+    for(int i=0; i<count; i++){
+        double wg = rf[i];
+        int c = 0;
+        for(int j=0; j<CUR162_NUM_LIMITS; j++)
+            c += !(wg <= CUR162_LIMITS[j]);
+        classes[i] = c;
+    }
+}
+
+static bool polygonContains(const QList<QPointF> &polygon, double x, double y)
+{
+    bool inside = false;
+    for(int i=0, j=polygon.count()-1; i<polygon.count(); j=i++){
+        const QPointF &a = polygon.at(i);
+        const QPointF &b = polygon.at(j);
+        if(((a.y() > y) != (b.y() > y)) &&
+           (x < (b.x() - a.x()) * (y - a.y()) / (b.y() - a.y()) + a.x()))
+            inside = !inside;
+    }
+    return inside;
+}
+
+QcRfClassifier::QcRfClassifier(const QString &name, const QList<sChartZone> &zones,
+                               double rfMax, double logQcMin, double logQcMax,
+                               int columns, int rows)
+{
+    m_name = name;
+    m_columns = qMax(1, columns);
+    m_rows = qMax(1, rows);
+    m_logQcMin = logQcMin;
+    m_columnScale = m_columns / rfMax;
+    m_rowScale = m_rows / (logQcMax - logQcMin);
+
+    QStringList names;
+    QList<int> ids;
+    for(int z=0; z<zones.count(); z++){
+        names.append(zones.at(z).name);
+        ids.append(zones.at(z).defaultSoilTypeId);
+    }
+    setClasses(names, ids);
+
+    //rasterize the zones on the cell centers, the first zone that contains a center wins
+    m_grid.fill(-1, m_columns * m_rows);
+    for(int r=0; r<m_rows; r++){
+        double y = m_logQcMin + (r + 0.5) / m_rowScale;
+        for(int c=0; c<m_columns; c++){
+            double x = (c + 0.5) / m_columnScale;
+            for(int z=0; z<zones.count(); z++){
+                if(polygonContains(zones.at(z).polygon, x, y)){
+                    m_grid[r * m_columns + c] = z;
+                    break;
+                }
+            }
+        }
+    }
+
+    //cells outside all zones get the class of the nearest cell inside one
+    //(in steps between neighbouring cells), grown outwards from the zones
+    QVector<int> queue;
+    queue.reserve(m_grid.count());
+    for(int i=0; i<m_grid.count(); i++)
+        if(m_grid.at(i) != -1)
+            queue.append(i);
+    for(int q=0; q<queue.count(); q++){
+        int i = queue.at(q);
+        int r = i / m_columns;
+        int c = i % m_columns;
+        int neighbours[4] = {c > 0 ? i - 1 : -1, c < m_columns - 1 ? i + 1 : -1,
+                             r > 0 ? i - m_columns : -1, r < m_rows - 1 ? i + m_columns : -1};
+        for(int n=0; n<4; n++){
+            if(neighbours[n] != -1 && m_grid.at(neighbours[n]) == -1){
+                m_grid[neighbours[n]] = m_grid.at(i);
+                queue.append(neighbours[n]);
+            }
+        }
+    }
+    if(queue.isEmpty())
+        m_grid.fill(0);
+    if(zones.count()==0)
+        qDebug() << QString("QcRfClassifier(%1) has no zones").arg(name);
+}
+
+/*
+    A simple qc / rf chart with sand, silty sand, clay and peat zones. The
+    boundaries are straight lines in the rf / log10(qc) plane, load a chart
+    that is calibrated for the area with readZones if one is available.
+ */
+QList<sChartZone> QcRfClassifier::defaultZones()
+{
+    QList<sChartZone> zones;
+    sChartZone zone;
+
+    zone.name = "zand";
+    zone.defaultSoilTypeId = 10002;
+    zone.polygon = QList<QPointF>() << QPointF(0., -1.) << QPointF(0.4, -1.) << QPointF(1.6, 2.) << QPointF(0., 2.);
+    zones.append(zone);
+
+    zone.name = "zand siltig";
+    zone.defaultSoilTypeId = 10004;
+    zone.polygon = QList<QPointF>() << QPointF(0.4, -1.) << QPointF(1.0, -1.) << QPointF(2.8, 2.) << QPointF(1.6, 2.);
+    zones.append(zone);
+
+    zone.name = "veen";
+    zone.defaultSoilTypeId = 10009;
+    zone.polygon = QList<QPointF>() << QPointF(5., -1.) << QPointF(10., -1.) << QPointF(10., 0.18) << QPointF(5., 0.18);
+    zones.append(zone);
+
+    zone.name = "klei";
+    zone.defaultSoilTypeId = 10007;
+    zone.polygon = QList<QPointF>() << QPointF(1.0, -1.) << QPointF(10., -1.) << QPointF(10., 2.) << QPointF(2.8, 2.);
+    zones.append(zone);
+
+    return zones;
+}
+
+/*
+    Reads the zones of a chart from a text file, one zone per line like
+    name;default soiltype id;rf logqc;rf logqc;rf logqc[;...]
+    Empty lines and lines starting with # are skipped.
+ */
+bool QcRfClassifier::readZones(const QString &fileName, QList<sChartZone> &zones, QStringList &log)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        log.append(QString("Could not open chart file %1").arg(fileName));
+        return false;
+    }
+
+    zones.clear();
+    QTextStream in(&file);
+    int lineNumber = 0;
+    bool result = true;
+    while(!in.atEnd()){
+        QString line = in.readLine().trimmed();
+        lineNumber++;
+        if(line.isEmpty() || line.startsWith("#"))
+            continue;
+
+        QStringList args = line.split(";");
+        bool ok = args.count() >= 5;
+        sChartZone zone;
+        if(ok){
+            zone.name = args.at(0).trimmed();
+            zone.defaultSoilTypeId = args.at(1).trimmed().toInt(&ok);
+        }
+        for(int i=2; ok && i<args.count(); i++){
+            QStringList xy = args.at(i).trimmed().split(" ", QString::SkipEmptyParts);
+            bool okX = false, okY = false;
+            if(xy.count() == 2)
+                zone.polygon.append(QPointF(xy.at(0).toDouble(&okX), xy.at(1).toDouble(&okY)));
+            ok = okX && okY;
+        }
+        if(ok){
+            zones.append(zone);
+        }else{
+            log.append(QString("Invalid zone on line %1 of chart file %2").arg(lineNumber).arg(fileName));
+            result = false;
+        }
+    }
+    file.close();
+    return result && zones.count() > 0;
+}
+
+void QcRfClassifier::classify(const double *qc, const double *rf, int count, int *classes) const
+{
+    const int *grid = m_grid.constData();
+    for(int i=0; i<count; i++){
+        //NaN and values outside the grid end up in the border cells
+        double x = rf[i] * m_columnScale;
+        double y = (qc[i] > 0.) ? (std::log10(qc[i]) - m_logQcMin) * m_rowScale : 0.;
+        int c = (x > 0.) ? ((x < m_columns) ? int(x) : m_columns - 1) : 0;
+        int r = (y > 0.) ? ((y < m_rows) ? int(y) : m_rows - 1) : 0;
+        classes[i] = grid[r * m_columns + c];
+    }
+}
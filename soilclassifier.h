@@ -0,0 +1,98 @@
+#ifndef SOILCLASSIFIER_H
+#define SOILCLASSIFIER_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QPointF>
+
+#include "soiltype.h"
+
+/*
+    Base class of the charts that translate cpt values into soiltypes.
+    A chart has a fixed list of classes with a default soiltype id each.
+    With setMapByName the classes are matched by name against the soiltypes
+    in the database instead (see mapToSoilTypes), classes without a
+    matching soiltype keep their default soiltype id.
+    classify works on whole arrays so a cpt (or all intervals of a cpt) is
+    classified in one call. After mapping a classifier is only read so it can
+    be shared between threads.
+ */
+class SoilClassifier
+{
+public:
+    virtual ~SoilClassifier() {}
+
+    virtual QString name() const = 0;
+    //qc [MPa] and rf (wg) [%] in, class number (0..numClasses()-1) out
+    virtual void classify(const double *qc, const double *rf, int count, int *classes) const = 0;
+
+    int numClasses() const { return m_classNames.count(); }
+    QString className(int c) const { return m_classNames.at(c); }
+    int soilTypeId(int c) const { return m_soilTypeIds.at(c); }
+    void classifyToSoilTypeIds(const double *qc, const double *rf, int count, int *soilTypeIds) const;
+    int mapToSoilTypes(const QList<SoilType*> &soilTypes, QStringList &log);
+    bool mapByName() const { return m_mapByName; }
+    void setMapByName(bool mapByName) { m_mapByName = mapByName; }
+
+protected:
+    SoilClassifier() : m_mapByName(false) {}
+
+    void setClasses(const QStringList &names, const QList<int> &defaultSoilTypeIds);
+
+private:
+    QStringList m_classNames;
+    QVector<int> m_defaultSoilTypeIds; //used if there is no soiltype with the name of the class
+    QVector<int> m_soilTypeIds;        //class -> soiltype id
+    bool m_mapByName;                  //off: always use the default ids
+};
+
+/*
+    The friction ratio table from CUR162 (electrical cone), qc is not used
+ */
+class CUR162Classifier : public SoilClassifier
+{
+public:
+    CUR162Classifier();
+
+    QString name() const { return "CUR162"; }
+    void classify(const double *qc, const double *rf, int count, int *classes) const;
+};
+
+struct sChartZone{
+    QString name;          //name of the class, matched against the soiltype names
+    int defaultSoilTypeId; //soiltype id if there is no soiltype with this name
+    QList<QPointF> polygon; //x = rf [%], y = log10(qc [MPa])
+};
+
+/*
+    A two dimensional qc / rf chart. The zones of the chart are rasterized
+    once into a lookup grid over rf (horizontal) and log10(qc) (vertical),
+    classifying a value is an index calculation and a table lookup. Values
+    outside of the grid get the class of the nearest border cell.
+ */
+class QcRfClassifier : public SoilClassifier
+{
+public:
+    QcRfClassifier(const QString &name, const QList<sChartZone> &zones,
+                   double rfMax = 10., double logQcMin = -1., double logQcMax = 2.,
+                   int columns = 200, int rows = 150);
+
+    static QList<sChartZone> defaultZones();
+    static bool readZones(const QString &fileName, QList<sChartZone> &zones, QStringList &log);
+
+    QString name() const { return m_name; }
+    void classify(const double *qc, const double *rf, int count, int *classes) const;
+
+private:
+    QString m_name;
+    double m_logQcMin;
+    double m_columnScale; //cells per % rf
+    double m_rowScale;    //cells per log10(MPa)
+    int m_columns;
+    int m_rows;
+    QVector<int> m_grid;  //class per cell, row by row starting at the lowest qc
+};
+
+#endif // SOILCLASSIFIER_H
@@ -6,12 +6,31 @@ SoilLayerTableModel::SoilLayerTableModel(QObject *parent) :
     QAbstractTableModel(parent)
 {
     m_soilLayers = NULL;
+    m_vsoil = NULL;
 }
 
-SoilLayerTableModel::SoilLayerTableModel(QList<VSoilLayer> *soilLayers, QObject *parent)
+SoilLayerTableModel::SoilLayerTableModel(VSoilLayerList *soilLayers, QObject *parent)
 {
     Q_UNUSED(parent);
     m_soilLayers = soilLayers;
+    m_vsoil = NULL;
+}
+
+/*
+  Edits the layers of the vsoil, use this one instead of the list so the
+  averages of the vsoil (see VSoil::setLayerIntegral) are updated
+  */
+SoilLayerTableModel::SoilLayerTableModel(VSoil *vsoil, QObject *parent) :
+    QAbstractTableModel(parent)
+{
+    m_soilLayers = vsoil->getSoilLayers();
+    m_vsoil = vsoil;
+}
+
+void SoilLayerTableModel::layersChanged()
+{
+    if(m_vsoil)
+        m_vsoil->clearLayerIntegrals();
 }
 
 int SoilLayerTableModel::rowCount(const QModelIndex &parent) const
@@ -110,6 +129,7 @@ bool SoilLayerTableModel::setData(const QModelIndex &index, const QVariant &valu
             vs2.zmax = vs.zmin;
             m_soilLayers->replace(row+1, vs2);
         }
+        layersChanged();
         emit(dataChanged(index, index));
 
         return true;
@@ -142,6 +162,7 @@ bool SoilLayerTableModel::insertRows(int position, int rows, const QModelIndex &
         vs.soiltype_id = -1;
         m_soilLayers->insert(position, vs);
     }
+    layersChanged();
 
     endInsertRows();    
     return true;
@@ -155,6 +176,7 @@ bool SoilLayerTableModel::removeRows(int position, int rows, const QModelIndex &
     for (int row=0; row < rows; ++row) {
         m_soilLayers->removeAt(position);
     }
+    layersChanged();
 
     endRemoveRows();
 
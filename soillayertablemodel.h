@@ -10,7 +10,8 @@ class SoilLayerTableModel : public QAbstractTableModel
     Q_OBJECT
 public:
     explicit SoilLayerTableModel(QObject *parent = 0);
-    explicit SoilLayerTableModel(QList<VSoilLayer> *soilLayers, QObject *parent = 0);
+    explicit SoilLayerTableModel(VSoilLayerList *soilLayers, QObject *parent = 0);
+    explicit SoilLayerTableModel(VSoil *vsoil, QObject *parent = 0);
 
     int rowCount(const QModelIndex &parent) const;
     int columnCount(const QModelIndex &parent) const;
@@ -24,10 +25,12 @@ public:
 
     void removeAllRows();
 
-    QList<VSoilLayer> *getSoilLayers() {return m_soilLayers;}
+    VSoilLayerList *getSoilLayers() {return m_soilLayers;}
 
 private:
-    QList<VSoilLayer> *m_soilLayers;
+    VSoilLayerList *m_soilLayers;
+    VSoil *m_vsoil; //owner of m_soilLayers if known, its cached averages are cleared on every edit
+    void layersChanged();
     
 signals:
     
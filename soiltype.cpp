@@ -1,7 +1,30 @@
 #include "soiltype.h"
 
+Q_STATIC_ASSERT(SOILTYPE_NUM_PARAMETERS == SoilType::Cv + 1);
+
 SoilType::SoilType(QObject *parent) :
     QObject(parent)
 {
-    m_dataChanged = false;
+    m_ownRecord = new sSoilTypeRecord;
+    m_record = m_ownRecord;
+}
+
+SoilType::SoilType(sSoilTypeRecord *record, QObject *parent) :
+    QObject(parent)
+{
+    m_ownRecord = NULL;
+    m_record = record;
+}
+
+SoilType::~SoilType()
+{
+    delete m_ownRecord;
+}
+
+void SoilType::setParameter(Parameter p, double d)
+{
+    if(m_record->parameters[p] == d)
+        return;
+    m_record->parameters[p] = d;
+    emit parametersChanged();
 }
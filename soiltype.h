@@ -4,99 +4,128 @@
 #include <QObject>
 #include <QString>
 
+#define SOILTYPE_NUM_PARAMETERS 20 //number of SoilType::Parameter values
+
+/*
+    The data of one soiltype as a plain value, see EntityStore for the
+    contiguous storage of these records and SoilType for the QObject around it
+ */
+struct sSoilTypeRecord{
+    sSoilTypeRecord() : id(-1), dataChanged(false) { for(int i=0; i<SOILTYPE_NUM_PARAMETERS; i++) parameters[i] = 0.; }
+
+    int id;             //id of the soiltype
+    bool dataChanged;   //shows whether the data has changed
+    double parameters[SOILTYPE_NUM_PARAMETERS]; //by SoilType::Parameter, see SoilType for the units
+    QString name;       //short name of the soiltype (sand / clay / loam / peat etc
+    QString description;//a longer descriptive name
+    QString source;     //source of the information
+    QString color;      //Color in HTML code, ie. #RRGGBB
+};
+
+/*
+    QObject facade of a sSoilTypeRecord for the GUI and the table models. A
+    SoilType either holds its own record or works on a record that lives in
+    an EntityStore, that record has to outlive the SoilType.
+ */
 class SoilType : public QObject
 {
     Q_OBJECT
 public:
+    //numeric properties, used to ask for a property by value (see parameter)
+    enum Parameter {
+        YDry,       //dry weight in kN/m3
+        YSat,       //saturated weight in kN/m3
+        C,          //cohesion kN/m
+        Phi,        //angle of friction [degrees]
+        Upsilon,    //#TODO opzoeken
+        K,          //permeability in [m/day]
+        MCUpsilon,  //PLAXIS MC model upsilon
+        MCE50,      //PLAXIS MC model E50 [MPa]
+        HSE50,      //PLAXIS HS model E50 [MPa]
+        HSEoed,     //PLAXIS HS model Eoedometer [MPa]
+        HSEur,      //PLAXIS HS model Eunload-reload [MPa]
+        HSm,        //PLAXIS stiffness-stress dependency
+        SSCLambda,  //PLAXIS SSC model lambda [-]
+        SSCKappa,   //PLAXIS SSC model kappa [-]
+        SSCMu,      //PLAXIS SSC model mu [-]
+        Cp,         //Compression index Cp [-]
+        Cap,        //Compression index C'p [-]
+        Cs,         //Compression index Cs [-]
+        Cas,        //Compression index C's [-]
+        Cv          //Cv value [m2/s]
+    };
+
     explicit SoilType(QObject *parent = 0);
+    explicit SoilType(sSoilTypeRecord *record, QObject *parent = 0);
+    ~SoilType();
+
+    sSoilTypeRecord *record() { return m_record; }
+    const sSoilTypeRecord *record() const { return m_record; }
 
     //getters
-    int id() { return m_id;}
-    QString name() {return m_name;}
-    QString description() {return m_description;}
-    QString source() {return m_source;}
-    double yDry() {return m_ydry;}
-    double ySat() {return m_ysat;}
-    double c() {return m_c;}
-    double phi() {return m_phi;}
-    double upsilon() {return m_upsilon;}
-    double k() {return m_k;}
-    double mcUpsilon() {return m_MC_upsilon;}
-    double mcE50() {return m_MC_E50;}
-    double hsE50() {return m_HS_E50;}
-    double hsEoed() {return m_HS_Eoed;}
-    double hsEur() {return m_HS_Eur; }
-    double hsM() {return m_HS_m;}
-    double sscLambda() {return m_SSC_lambda;}
-    double sscKappa() {return m_SSC_kappa;}
-    double sscMu() {return m_SSC_mu;}
-    double cp() {return m_Cp;}
-    double cap() {return m_Cap;}
-    double cs() {return m_Cs;}
-    double cas() {return m_Cas;}
-    double cv() {return m_cv;}
-    QString color() {return m_color;}
-    bool dataChanged() { return m_dataChanged; }
+    int id() { return m_record->id;}
+    QString name() {return m_record->name;}
+    QString description() {return m_record->description;}
+    QString source() {return m_record->source;}
+    double yDry() {return m_record->parameters[YDry];}
+    double ySat() {return m_record->parameters[YSat];}
+    double c() {return m_record->parameters[C];}
+    double phi() {return m_record->parameters[Phi];}
+    double upsilon() {return m_record->parameters[Upsilon];}
+    double k() {return m_record->parameters[K];}
+    double mcUpsilon() {return m_record->parameters[MCUpsilon];}
+    double mcE50() {return m_record->parameters[MCE50];}
+    double hsE50() {return m_record->parameters[HSE50];}
+    double hsEoed() {return m_record->parameters[HSEoed];}
+    double hsEur() {return m_record->parameters[HSEur]; }
+    double hsM() {return m_record->parameters[HSm];}
+    double sscLambda() {return m_record->parameters[SSCLambda];}
+    double sscKappa() {return m_record->parameters[SSCKappa];}
+    double sscMu() {return m_record->parameters[SSCMu];}
+    double cp() {return m_record->parameters[Cp];}
+    double cap() {return m_record->parameters[Cap];}
+    double cs() {return m_record->parameters[Cs];}
+    double cas() {return m_record->parameters[Cas];}
+    double cv() {return m_record->parameters[Cv];}
+    QString color() {return m_record->color;}
+    double parameter(Parameter p) {return m_record->parameters[p];}
+    bool dataChanged() { return m_record->dataChanged; }
 
     //setters
-    void setId(int i) { m_id = i;}
-    void setName(QString s) {m_name = s;}
-    void setDescription(QString s) {m_description = s;}
-    void setSource(QString s) {m_source = s;}
-    void setYdry(double d) {m_ydry = d;}
-    void setYsat(double d) {m_ysat = d;}
-    void setC(double d) {m_c = d;}
-    void setPhi(double d) {m_phi = d;}
-    void setUpsilon(double d) {m_upsilon = d;}
-    void setK(double d) {m_k = d;}
-    void setMCUpsilon(double d) {m_MC_upsilon = d;}
-    void setMCE50(double d) {m_MC_E50 = d;}
-    void setHSE50(double d) {m_HS_E50 = d;}
-    void setHSEoed(double d) {m_HS_Eoed = d;}
-    void setHSEur(double d) {m_HS_Eur = d;}
-    void setHSm(double d) {m_HS_m = d;}
-    void setSSClambda(double d) {m_SSC_lambda = d;}
-    void setSSCkappa(double d) {m_SSC_kappa = d;}
-    void setSSCmu(double d) {m_SSC_mu = d;}
-    void setCp(double d) {m_Cp = d;}
-    void setCap(double d) {m_Cap = d;}
-    void setCs(double d) {m_Cs = d;}
-    void setCas(double d) {m_Cas = d;}
-    void setCv(double d) {m_cv = d;}
-    void setColor(QString s) {m_color = s;}
-    void setDataChanged(bool dataHasChanged) { m_dataChanged = dataHasChanged; }
+    void setId(int i) { m_record->id = i;}
+    void setName(QString s) {m_record->name = s;}
+    void setDescription(QString s) {m_record->description = s;}
+    void setSource(QString s) {m_record->source = s;}
+    void setYdry(double d) {setParameter(YDry, d);}
+    void setYsat(double d) {setParameter(YSat, d);}
+    void setC(double d) {setParameter(C, d);}
+    void setPhi(double d) {setParameter(Phi, d);}
+    void setUpsilon(double d) {setParameter(Upsilon, d);}
+    void setK(double d) {setParameter(K, d);}
+    void setMCUpsilon(double d) {setParameter(MCUpsilon, d);}
+    void setMCE50(double d) {setParameter(MCE50, d);}
+    void setHSE50(double d) {setParameter(HSE50, d);}
+    void setHSEoed(double d) {setParameter(HSEoed, d);}
+    void setHSEur(double d) {setParameter(HSEur, d);}
+    void setHSm(double d) {setParameter(HSm, d);}
+    void setSSClambda(double d) {setParameter(SSCLambda, d);}
+    void setSSCkappa(double d) {setParameter(SSCKappa, d);}
+    void setSSCmu(double d) {setParameter(SSCMu, d);}
+    void setCp(double d) {setParameter(Cp, d);}
+    void setCap(double d) {setParameter(Cap, d);}
+    void setCs(double d) {setParameter(Cs, d);}
+    void setCas(double d) {setParameter(Cas, d);}
+    void setCv(double d) {setParameter(Cv, d);}
+    void setColor(QString s) {m_record->color = s;}
+    void setParameter(Parameter p, double d);
+    void setDataChanged(bool dataHasChanged) { m_record->dataChanged = dataHasChanged; }
 
 private:
-    int m_id;             //id of the soiltype
-    QString m_name;       //short name of the soiltype (sand / clay / loam / peat etc
-    QString m_description;//a longer descriptive name
-    QString m_source;     //source of the information
-    double m_ydry;      //dry weight in kN/m3
-    double m_ysat;      //saturated weight in kN/m3
-    double m_c;         //cohesion kN/m
-    double m_phi;       //angle of friction [degrees]
-    double m_upsilon;   //#TODO opzoeken
-    double m_k;         //permeability in [m/day]
-    double m_MC_upsilon;//PLAXIS MC model upsilon
-    double m_MC_E50;    //PLAXIS MC model E50 [MPa]
-    double m_HS_E50;    //PLAXIS HS model E50 [MPa]
-    double m_HS_Eoed;   //PLAXIS HS model Eoedometer [MPa]
-    double m_HS_Eur;    //PLAXIS HS model Eunload-reload [MPa]
-    double m_HS_m;      //PLAXIS stiffness-stress dependency
-    double m_SSC_lambda;//PLAXIS SSC model lambda [-]
-    double m_SSC_kappa; //PLAXIS SSC model kappa [-]
-    double m_SSC_mu;    //PLAXIS SSC model mu [-]
-    double m_Cp;        //Compression index Cp [-]
-    double m_Cs;        //Compression index Cs [-]
-    double m_Cap;       //Compression index C'p [-]
-    double m_Cas;       //Compression index C's [-]
-    double m_cv;        //Cv value [m2/s]
-    QString m_color;    //Color in HTML code, ie. #RRGGBB
-    bool m_dataChanged; //shows whether the data has changed
+    sSoilTypeRecord *m_ownRecord; //NULL if the record lives in an EntityStore
+    sSoilTypeRecord *m_record;    //m_ownRecord or the record in the store
 
-
-    
 signals:
+    void parametersChanged(); //one of the numeric properties got a new value
     
 public slots:
     
@@ -0,0 +1,376 @@
+#include "spatialindex.h"
+
+#include <QPair>
+#include <algorithm>
+#include <cmath>
+
+struct sLessX{
+    bool operator()(const sIndexPoint &a, const sIndexPoint &b) const { return a.x < b.x; }
+};
+
+struct sLessY{
+    bool operator()(const sIndexPoint &a, const sIndexPoint &b) const { return a.y < b.y; }
+};
+
+/*
+    Puts the median of [lo, hi) in the middle with the smaller values on the
+    left and the larger values on the right, then does the same for both halves
+ */
+static void buildRecursive(sIndexPoint *points, int lo, int hi, int depth)
+{
+    if(hi - lo < 2)
+        return;
+    int mid = (lo + hi) / 2;
+    if(depth % 2 == 0)
+        std::nth_element(points + lo, points + mid, points + hi, sLessX());
+    else
+        std::nth_element(points + lo, points + mid, points + hi, sLessY());
+    buildRecursive(points, lo, mid, depth + 1);
+    buildRecursive(points, mid + 1, hi, depth + 1);
+}
+
+static void nearestRecursive(const sIndexPoint *points, int lo, int hi, int depth,
+                             double x, double y, double &bestDistance, int &bestIndex)
+{
+    if(lo >= hi)
+        return;
+    int mid = (lo + hi) / 2;
+    const sIndexPoint &p = points[mid];
+    double dx = x - p.x;
+    double dy = y - p.y;
+    double dl = dx * dx + dy * dy;
+    if((dl < bestDistance) || ((bestIndex != -1) && (dl == bestDistance) && (p.index < bestIndex))){
+        bestDistance = dl;
+        bestIndex = p.index;
+    }
+    double diff = (depth % 2 == 0) ? dx : dy;
+    if(diff < 0){
+        nearestRecursive(points, lo, mid, depth + 1, x, y, bestDistance, bestIndex);
+        if(diff * diff <= bestDistance) //equal distances may still win on index
+            nearestRecursive(points, mid + 1, hi, depth + 1, x, y, bestDistance, bestIndex);
+    }else{
+        nearestRecursive(points, mid + 1, hi, depth + 1, x, y, bestDistance, bestIndex);
+        if(diff * diff <= bestDistance)
+            nearestRecursive(points, lo, mid, depth + 1, x, y, bestDistance, bestIndex);
+    }
+}
+
+/*
+    best is sorted on (distance, index) and holds at most k entries
+ */
+static void kNearestRecursive(const sIndexPoint *points, int lo, int hi, int depth,
+                              double x, double y, int k, QVector<QPair<double, int> > &best)
+{
+    if(lo >= hi)
+        return;
+    int mid = (lo + hi) / 2;
+    const sIndexPoint &p = points[mid];
+    double dx = x - p.x;
+    double dy = y - p.y;
+    QPair<double, int> candidate(dx * dx + dy * dy, p.index);
+    if((best.count() < k) || (candidate < best.last())){
+        if(best.count() == k)
+            best.removeLast();
+        best.insert(std::upper_bound(best.begin(), best.end(), candidate), candidate);
+    }
+    double diff = (depth % 2 == 0) ? dx : dy;
+    int nearLo = (diff < 0) ? lo : mid + 1;
+    int nearHi = (diff < 0) ? mid : hi;
+    int farLo = (diff < 0) ? mid + 1 : lo;
+    int farHi = (diff < 0) ? hi : mid;
+    kNearestRecursive(points, nearLo, nearHi, depth + 1, x, y, k, best);
+    if((best.count() < k) || (diff * diff <= best.last().first))
+        kNearestRecursive(points, farLo, farHi, depth + 1, x, y, k, best);
+}
+
+static void radiusRecursive(const sIndexPoint *points, int lo, int hi, int depth,
+                            double x, double y, double radiusSquared, QList<int> &indexes)
+{
+    if(lo >= hi)
+        return;
+    int mid = (lo + hi) / 2;
+    const sIndexPoint &p = points[mid];
+    double dx = x - p.x;
+    double dy = y - p.y;
+    if(dx * dx + dy * dy <= radiusSquared)
+        indexes.append(p.index);
+    double diff = (depth % 2 == 0) ? dx : dy;
+    if((diff < 0) || (diff * diff <= radiusSquared))
+        radiusRecursive(points, lo, mid, depth + 1, x, y, radiusSquared, indexes);
+    if((diff >= 0) || (diff * diff <= radiusSquared))
+        radiusRecursive(points, mid + 1, hi, depth + 1, x, y, radiusSquared, indexes);
+}
+
+SpatialIndex::SpatialIndex()
+{
+    m_data = NULL;
+    m_count = 0;
+}
+
+void SpatialIndex::build(const QVector<sIndexPoint> &points)
+{
+    m_points = points;
+    buildRecursive(m_points.data(), 0, m_points.count(), 0);
+    m_data = m_points.constData();
+    m_count = m_points.count();
+}
+
+/*
+    Uses points that are already in kd-tree order (see points()) without
+    copying them
+ */
+void SpatialIndex::attach(const sIndexPoint *points, int count)
+{
+    m_points.clear();
+    m_data = points;
+    m_count = count;
+}
+
+void SpatialIndex::clear()
+{
+    m_points.clear();
+    m_data = NULL;
+    m_count = 0;
+}
+
+/*
+    Returns the index of the point closest to p or -1 if there is no point
+    closer than sqrt(maxDistanceSquared)
+ */
+int SpatialIndex::nearest(QPointF p, double maxDistanceSquared) const
+{
+    double bestDistance = maxDistanceSquared;
+    int bestIndex = -1;
+    nearestRecursive(m_data, 0, m_count, 0, p.x(), p.y(), bestDistance, bestIndex);
+    return bestIndex;
+}
+
+/*
+    Returns the indexes of the k points closest to p, closest first
+ */
+void SpatialIndex::kNearest(QPointF p, int k, QList<int> &indexes) const
+{
+    indexes.clear();
+    if(k <= 0)
+        return;
+    QVector<QPair<double, int> > best;
+    best.reserve(k + 1);
+    kNearestRecursive(m_data, 0, m_count, 0, p.x(), p.y(), k, best);
+    for(int i=0; i<best.count(); i++)
+        indexes.append(best.at(i).second);
+}
+
+/*
+    Returns the indexes of all points within radius of p, sorted on index
+ */
+void SpatialIndex::withinRadius(QPointF p, double radius, QList<int> &indexes) const
+{
+    indexes.clear();
+    radiusRecursive(m_data, 0, m_count, 0, p.x(), p.y(), radius * radius, indexes);
+    std::sort(indexes.begin(), indexes.end());
+}
+
+/*
+    Sort-tile-recursive packing of items (points or nodes of the level below)
+    with the given centers into nodes of at most capacity items. Sorts order
+    so that every new node covers a consecutive range of it.
+ */
+struct sCenter{
+    double x;
+    double y;
+    int item;
+};
+
+struct sCenterLessX{
+    bool operator()(const sCenter &a, const sCenter &b) const { return a.x < b.x; }
+};
+
+struct sCenterLessY{
+    bool operator()(const sCenter &a, const sCenter &b) const { return a.y < b.y; }
+};
+
+static void strPack(QVector<sCenter> &order, int capacity)
+{
+    int n = order.count();
+    int numNodes = (n + capacity - 1) / capacity;
+    int numSlices = int(std::ceil(std::sqrt(double(numNodes))));
+    int sliceSize = numSlices * capacity;
+    std::sort(order.begin(), order.end(), sCenterLessX());
+    for(int start=0; start<n; start+=sliceSize){
+        int end = qMin(n, start + sliceSize);
+        std::sort(order.begin() + start, order.begin() + end, sCenterLessY());
+    }
+}
+
+RTree::RTree()
+{
+    m_pointData = NULL;
+    m_pointCount = 0;
+    m_nodeData = NULL;
+    m_nodeCount = 0;
+}
+
+void RTree::clear()
+{
+    m_points.clear();
+    m_nodes.clear();
+    m_pointData = NULL;
+    m_pointCount = 0;
+    m_nodeData = NULL;
+    m_nodeCount = 0;
+}
+
+/*
+    Uses a tree that was built before (see points() and nodes()) without
+    copying it
+ */
+void RTree::attach(const sIndexPoint *points, int pointCount, const sRTreeNode *nodes, int nodeCount)
+{
+    clear();
+    m_pointData = points;
+    m_pointCount = pointCount;
+    m_nodeData = nodes;
+    m_nodeCount = nodeCount;
+}
+
+void RTree::build(const QVector<sIndexPoint> &points, int nodeCapacity)
+{
+    clear();
+    if(points.count()==0)
+        return;
+    int capacity = qMax(2, nodeCapacity);
+
+    //leaves
+    QVector<sCenter> order(points.count());
+    for(int i=0; i<points.count(); i++){
+        order[i].x = points[i].x;
+        order[i].y = points[i].y;
+        order[i].item = i;
+    }
+    strPack(order, capacity);
+    m_points.reserve(points.count());
+    for(int i=0; i<order.count(); i++)
+        m_points.append(points[order[i].item]);
+
+    int levelStart = 0;
+    for(int start=0; start<m_points.count(); start+=capacity){
+        sRTreeNode node;
+        node.level = 0;
+        node.first = start;
+        node.count = qMin(capacity, m_points.count() - start);
+        node.minX = node.maxX = m_points[start].x;
+        node.minY = node.maxY = m_points[start].y;
+        for(int i=start+1; i<start+node.count; i++){
+            node.minX = qMin(node.minX, m_points[i].x);
+            node.maxX = qMax(node.maxX, m_points[i].x);
+            node.minY = qMin(node.minY, m_points[i].y);
+            node.maxY = qMax(node.maxY, m_points[i].y);
+        }
+        m_nodes.append(node);
+    }
+
+    //upper levels until there is one root left
+    int level = 1;
+    while(m_nodes.count() - levelStart > 1){
+        int levelEnd = m_nodes.count();
+        QVector<sCenter> nodeOrder(levelEnd - levelStart);
+        for(int i=levelStart; i<levelEnd; i++){
+            nodeOrder[i-levelStart].x = 0.5 * (m_nodes[i].minX + m_nodes[i].maxX);
+            nodeOrder[i-levelStart].y = 0.5 * (m_nodes[i].minY + m_nodes[i].maxY);
+            nodeOrder[i-levelStart].item = i;
+        }
+        strPack(nodeOrder, capacity);
+        //put the children in packed order so every parent covers a consecutive range
+        QVector<sRTreeNode> children;
+        children.reserve(nodeOrder.count());
+        for(int i=0; i<nodeOrder.count(); i++)
+            children.append(m_nodes[nodeOrder[i].item]);
+        for(int i=0; i<children.count(); i++)
+            m_nodes[levelStart + i] = children[i];
+
+        for(int start=levelStart; start<levelEnd; start+=capacity){
+            sRTreeNode node;
+            node.level = level;
+            node.first = start;
+            node.count = qMin(capacity, levelEnd - start);
+            node.minX = m_nodes[start].minX;
+            node.maxX = m_nodes[start].maxX;
+            node.minY = m_nodes[start].minY;
+            node.maxY = m_nodes[start].maxY;
+            for(int i=start+1; i<start+node.count; i++){
+                node.minX = qMin(node.minX, m_nodes[i].minX);
+                node.maxX = qMax(node.maxX, m_nodes[i].maxX);
+                node.minY = qMin(node.minY, m_nodes[i].minY);
+                node.maxY = qMax(node.maxY, m_nodes[i].maxY);
+            }
+            m_nodes.append(node);
+        }
+        levelStart = levelEnd;
+        level++;
+    }
+    m_pointData = m_points.constData();
+    m_pointCount = m_points.count();
+    m_nodeData = m_nodes.constData();
+    m_nodeCount = m_nodes.count();
+}
+
+struct sIndexLess{
+    bool operator()(const sIndexPoint &a, const sIndexPoint &b) const { return a.index < b.index; }
+};
+
+static void queryRecursive(const sRTreeNode *nodes, const sIndexPoint *points, int nodeIndex,
+                           double minX, double minY, double maxX, double maxY, QVector<sIndexPoint> &found)
+{
+    const sRTreeNode &node = nodes[nodeIndex];
+    if((node.maxX < minX) || (node.minX > maxX) || (node.maxY < minY) || (node.minY > maxY))
+        return;
+    if(node.level == 0){
+        for(int i=node.first; i<node.first+node.count; i++){
+            const sIndexPoint &p = points[i];
+            if((p.y >= minY) && (p.y <= maxY) && (p.x >= minX) && (p.x <= maxX))
+                found.append(p);
+        }
+    }else{
+        for(int i=node.first; i<node.first+node.count; i++)
+            queryRecursive(nodes, points, i, minX, minY, maxX, maxY, found);
+    }
+}
+
+/*
+    Returns the indexes of all points within the rectangle (borders included),
+    sorted on index. If maxResults > 0 and more points are found only the
+    first point in every cell of a sqrt(maxResults) x sqrt(maxResults) grid
+    over the rectangle is returned.
+ */
+void RTree::query(double minX, double minY, double maxX, double maxY, QList<int> &indexes, int maxResults) const
+{
+    indexes.clear();
+    if(m_nodeCount==0)
+        return;
+    QVector<sIndexPoint> found;
+    queryRecursive(m_nodeData, m_pointData, m_nodeCount - 1,
+                   minX, minY, maxX, maxY, found);
+    std::sort(found.begin(), found.end(), sIndexLess());
+
+    if((maxResults <= 0) || (found.count() <= maxResults)){
+        indexes.reserve(found.count());
+        for(int i=0; i<found.count(); i++)
+            indexes.append(found[i].index);
+        return;
+    }
+
+    int gridSize = qMax(1, int(std::sqrt(double(maxResults))));
+    double width = maxX - minX;
+    double height = maxY - minY;
+    QVector<bool> occupied(gridSize * gridSize, false);
+    for(int i=0; i<found.count(); i++){
+        int col = (width > 0.) ? int((found[i].x - minX) / width * gridSize) : 0;
+        int row = (height > 0.) ? int((found[i].y - minY) / height * gridSize) : 0;
+        col = qBound(0, col, gridSize - 1);
+        row = qBound(0, row, gridSize - 1);
+        if(!occupied[row * gridSize + col]){
+            occupied[row * gridSize + col] = true;
+            indexes.append(found[i].index);
+        }
+    }
+}
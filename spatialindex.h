@@ -0,0 +1,86 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <QVector>
+#include <QList>
+#include <QPointF>
+
+struct sIndexPoint{
+    double x;
+    double y;
+    int index; //position of the item in the list the index was built from
+};
+
+/*
+    A 2D kd-tree stored implicitly in one array; every range [lo, hi) is
+    split at its middle element, alternating between x and y. The searches
+    return the same items as a linear scan would, ties in distance are
+    resolved by taking the lowest index.
+    The tree can also be attached to points that are stored elsewhere (for
+    example a mapped snapshot file), the points must stay valid while they
+    are attached.
+ */
+class SpatialIndex
+{
+public:
+    SpatialIndex();
+
+    void build(const QVector<sIndexPoint> &points);
+    void attach(const sIndexPoint *points, int count);
+    void clear();
+    int count() const { return m_count; }
+    const sIndexPoint *points() const { return m_data; } //in kd-tree order
+
+    int nearest(QPointF p, double maxDistanceSquared = 1e9) const;
+    void kNearest(QPointF p, int k, QList<int> &indexes) const;
+    void withinRadius(QPointF p, double radius, QList<int> &indexes) const;
+
+private:
+    QVector<sIndexPoint> m_points; //in kd-tree order, empty if attached
+    const sIndexPoint *m_data;     //m_points or the attached points
+    int m_count;
+};
+
+struct sRTreeNode{
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+    int level; //0 = leaf, the children are points
+    int first; //first child (point or node)
+    int count; //number of children
+};
+
+/*
+    A static R-tree packed with the sort-tile-recursive method. Used for
+    rectangle (viewport) queries, the results are sorted on index so they
+    come out in the same order as a linear scan would give them.
+    If more than maxResults points are found they are thinned out on a grid
+    so dense areas lose points while sparse areas keep them.
+ */
+class RTree
+{
+public:
+    RTree();
+
+    void build(const QVector<sIndexPoint> &points, int nodeCapacity = 16);
+    void attach(const sIndexPoint *points, int pointCount, const sRTreeNode *nodes, int nodeCount);
+    void clear();
+    int count() const { return m_pointCount; }
+    const sIndexPoint *points() const { return m_pointData; } //in leaf order
+    const sRTreeNode *nodes() const { return m_nodeData; }
+    int nodeCount() const { return m_nodeCount; }
+
+    void query(double minX, double minY, double maxX, double maxY, QList<int> &indexes, int maxResults = 0) const;
+
+private:
+    QVector<sIndexPoint> m_points; //in leaf order
+    QVector<sRTreeNode> m_nodes; //all levels, the root is the last node
+    //m_points and m_nodes or the attached arrays
+    const sIndexPoint *m_pointData;
+    int m_pointCount;
+    const sRTreeNode *m_nodeData;
+    int m_nodeCount;
+};
+
+#endif // SPATIALINDEX_H
@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# tests, unit tests for libbbgeo on the headless core, the fixtures come
+# from the benchmark data generators
+#
+#-------------------------------------------------
+
+QT       = core sql concurrent testlib
+
+TARGET = tst_libbbgeo
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+include(../libbbgeo.pri)
+
+INCLUDEPATH += ../bench
+
+SOURCES += tst_datastore.cpp \
+    ../bench/benchdata.cpp
+
+HEADERS += ../bench/benchdata.h
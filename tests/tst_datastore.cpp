@@ -0,0 +1,88 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QDir>
+
+#include "benchdata.h"
+#include "cpt.h"
+#include "vsoil.h"
+#include "datastore.h"
+
+class TestDataStore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void blobToDataReplacesLayers();
+    void regenerateCPTVSoilsReplacesLayers();
+};
+
+void TestDataStore::blobToDataReplacesLayers()
+{
+    VSoil vs;
+    vs.addSoilLayer(0., -1., 1);
+    vs.addSoilLayer(-1., -3., 2);
+    vs.addSoilLayer(-3., -4., 3);
+
+    VSoilLayerList layers;
+    VSoilLayer sl;
+    sl.zmax = 1.;
+    sl.zmin = -2.;
+    sl.soiltype_id = 5;
+    layers.append(sl);
+    vs.blobToData(VSoil::layersToBlob(layers));
+
+    QCOMPARE(vs.getSoilLayers()->count(), 1);
+    QCOMPARE(vs.zMax(), 1.);
+    QCOMPARE(vs.zMin(), -2.);
+    QCOMPARE(vs.getSoilLayers()->at(0).soiltype_id, 5);
+}
+
+/*
+  Imports one cpt and regenerates its vsoil, the vsoil in memory has to end
+  up with the same layers as the database and not with the new layers added
+  to the old ones
+  */
+void TestDataStore::regenerateCPTVSoilsReplacesLayers()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QDir dir(tempDir.path());
+    QVERIFY(dir.mkdir("gef"));
+    QString dbFile = dir.filePath("regenerate.db");
+    QStringList log;
+    QVERIFY(BenchData::writeDatabase(dbFile, 0, 50., 1, log));
+    BenchData::writeRealShapedGEF(dir.filePath("gef"), 20., 7);
+
+    int numLayers, numRegeneratedLayers;
+    {
+        DataStore store;
+        QVERIFY(store.loadDataNonUI(dbFile));
+        QVERIFY(store.importCPTS(dir.filePath("gef"), log));
+        QCOMPARE(store.getVSoils().count(), 1);
+        VSoil *vs = store.getVSoils().first();
+        numLayers = vs->getSoilLayers()->count();
+        QVERIFY(numLayers > 0);
+
+        //same settings, so the same layers
+        log.clear();
+        QVERIFY(store.regenerateCPTVSoils(log));
+        QVERIFY(log.contains("Regenerated 1 vsoils, 0 edited vsoils were left untouched."));
+        QCOMPARE(vs->getSoilLayers()->count(), numLayers);
+
+        //other settings, the vsoil is still recognized as generated
+        log.clear();
+        QVERIFY(store.regenerateCPTVSoils(log, 1.0));
+        QVERIFY(log.contains("Regenerated 1 vsoils, 0 edited vsoils were left untouched."));
+        numRegeneratedLayers = vs->getSoilLayers()->count();
+        QVERIFY(numRegeneratedLayers > 0);
+    }
+
+    DataStore reloaded;
+    QVERIFY(reloaded.loadDataNonUI(dbFile));
+    QCOMPARE(reloaded.getVSoils().count(), 1);
+    QCOMPARE(reloaded.getVSoils().first()->getSoilLayers()->count(), numRegeneratedLayers);
+}
+
+QTEST_GUILESS_MAIN(TestDataStore)
+
+#include "tst_datastore.moc"
@@ -0,0 +1,48 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <QtGlobal>
+
+/*
+    Little helpers for the binary blobs (see VSoil and CPT), unsigned values
+    are stored 7 bits per byte with the high bit set if more bytes follow,
+    signed values are zigzag encoded first so small negative numbers stay small.
+ */
+
+inline quint64 zigzag(qint64 value) { return (quint64(value) << 1) ^ quint64(value >> 63); }
+inline qint64 unzigzag(quint64 value) { return qint64(value >> 1) ^ -qint64(value & 1); }
+
+inline int varintSize(quint64 value)
+{
+    int size = 1;
+    while(value >= 0x80){
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+inline char *putVarint(char *p, quint64 value)
+{
+    while(value >= 0x80){
+        *p++ = char((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    *p++ = char(value);
+    return p;
+}
+
+//returns NULL if the varint runs past end
+inline const char *getVarint(const char *p, const char *end, quint64 &value)
+{
+    value = 0;
+    for(int shift=0; shift<70 && p<end; shift+=7){
+        uchar b = uchar(*p++);
+        value |= quint64(b & 0x7F) << shift;
+        if(!(b & 0x80))
+            return p;
+    }
+    return NULL;
+}
+
+#endif // VARINT_H
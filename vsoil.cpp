@@ -1,5 +1,20 @@
 #include "vsoil.h"
 
+#include <QDebug>
+#include <QtEndian>
+#include <QHash>
+#include <string.h>
+
+#include "varint.h"
+
+//layout of the binary blob, see dataAsQByteArray
+#define VSOILBLOB_MAGIC0 char(0xBB)
+#define VSOILBLOB_MAGIC1 'V'
+#define VSOILBLOB_VERSION 1
+#define VSOILBLOB_HEADERSIZE 4
+#define VSOILBLOB_FLOATDEPTHS 0x01 //depths are stored as float instead of double
+#define VSOILBLOB_CONTIGUOUS 0x02  //zmax of a layer equals zmin of the layer above, only the top zmax is stored
+
 /*
     A VSoil object contains information of soil layers that are stacked
     on top of each other (like in a borehole). VSoil stands for vertical soil
@@ -13,32 +28,64 @@
 VSoil::VSoil(QObject *parent) :
     QObject(parent)
 {
-    m_id = -1;
-    m_source = "";
-    m_x = 0.;
-    m_y = 0.;
-    m_lat = 0.;
-    m_lng = 0.;
-    m_soilLayers = new QList<VSoilLayer>();
-    m_dataChanged = false;
-    m_name = "";
-    m_leveeLocation = 0;
-    m_enabled = true;
+    m_ownRecord = new sVSoilRecord;
+    m_record = m_ownRecord;
+}
+
+VSoil::VSoil(sVSoilRecord *record, QObject *parent) :
+    QObject(parent)
+{
+    m_ownRecord = NULL;
+    m_record = record;
 }
 
 VSoil::~VSoil()
 {
-    m_soilLayers->clear();
-    m_soilLayers = NULL;
+    delete m_ownRecord;
+    m_record = NULL;
+}
+
+static char *putDepth(char *p, double z, bool asFloat)
+{
+    if(asFloat){
+        float f = float(z);
+        quint32 bits;
+        memcpy(&bits, &f, 4);
+        qToLittleEndian(bits, reinterpret_cast<uchar*>(p));
+        return p + 4;
+    }
+    quint64 bits;
+    memcpy(&bits, &z, 8);
+    qToLittleEndian(bits, reinterpret_cast<uchar*>(p));
+    return p + 8;
+}
+
+static double getDepth(const char *p, bool asFloat)
+{
+    if(asFloat){
+        quint32 bits = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(p));
+        float f;
+        memcpy(&f, &bits, 4);
+        return f;
+    }
+    quint64 bits = qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(p));
+    double z;
+    memcpy(&z, &bits, 8);
+    return z;
 }
 
 /*
-    Reads a blob from the database with the layout
-    top;bottom;soillayer_id
+    Returns true if data is in the binary layout written by dataAsQByteArray,
+    the legacy text blobs never start with the magic byte 0xBB
  */
-void VSoil::blobToData(QString data)
+bool VSoil::isBinaryBlob(const QByteArray &data)
+{
+    return (data.size() >= VSOILBLOB_HEADERSIZE) && (data.at(0) == VSOILBLOB_MAGIC0) && (data.at(1) == VSOILBLOB_MAGIC1);
+}
+
+static void textBlobToLayers(const QByteArray &data, VSoilLayerList &layers)
 {
-    QStringList lines = data.split("\n");
+    QStringList lines = QString::fromUtf8(data).split("\n");
     for(int i=0; i<lines.count(); i++){
         QString line = lines[i];
         if(line.trimmed().count() > 0){
@@ -47,37 +94,148 @@ void VSoil::blobToData(QString data)
             vs.zmax = args[0].toDouble();
             vs.zmin = args[1].toDouble();
             vs.soiltype_id = args[2].toInt();
-            m_soilLayers->append(vs);
+            layers.append(vs);
         }
     }
 }
 
+static bool binaryBlobToLayers(const QByteArray &data, VSoilLayerList &layers)
+{
+    const char *p = data.constData();
+    const char *end = p + data.size();
+    if(uchar(p[2]) != VSOILBLOB_VERSION)
+        return false;
+    uchar flags = uchar(p[3]);
+    bool asFloat = flags & VSOILBLOB_FLOATDEPTHS;
+    bool contiguous = flags & VSOILBLOB_CONTIGUOUS;
+    int depthSize = asFloat ? 4 : 8;
+    p += VSOILBLOB_HEADERSIZE;
+
+    quint64 count;
+    p = getVarint(p, end, count);
+    if(p == NULL || count > quint64(data.size()))
+        return false;
+    layers.reserve(layers.count() + int(count));
+
+    double zmax = 0.;
+    if(contiguous && count > 0){
+        if(end - p < depthSize)
+            return false;
+        zmax = getDepth(p, asFloat);
+        p += depthSize;
+    }
+    for(quint64 i=0; i<count; i++){
+        VSoilLayer sl;
+        if(!contiguous){
+            if(end - p < depthSize)
+                return false;
+            zmax = getDepth(p, asFloat);
+            p += depthSize;
+        }
+        if(end - p < depthSize)
+            return false;
+        sl.zmax = zmax;
+        sl.zmin = getDepth(p, asFloat);
+        p += depthSize;
+        quint64 id;
+        p = getVarint(p, end, id);
+        if(p == NULL)
+            return false;
+        sl.soiltype_id = int(unzigzag(id));
+        layers.append(sl);
+        zmax = sl.zmin;
+    }
+    return true;
+}
+
 /*
-    Returns a string like;
-    top;bottom;soillayer_id
+    Appends the layers in a blob from the database to layers, the blob is
+    either in the binary layout (see dataAsQByteArray) or in the legacy text
+    layout top;bottom;soillayer_id
+    Returns false (and leaves no layers) if a binary blob is damaged.
  */
-QByteArray VSoil::dataAsQByteArray(){
-    QByteArray result;
-    for(int i=0; i<m_soilLayers->count(); i++){
-        result.append(QString("%1;%2;%3\n")
-                      .arg(m_soilLayers->at(i).zmax, 2, 'f')
-                      .arg(m_soilLayers->at(i).zmin, 2, 'f')
-                      .arg(m_soilLayers->at(i).soiltype_id));
+bool VSoil::blobToLayers(const QByteArray &data, VSoilLayerList &layers)
+{
+    if(isBinaryBlob(data)){
+        if(!binaryBlobToLayers(data, layers)){
+            layers.clear();
+            return false;
+        }
+    }else{
+        textBlobToLayers(data, layers);
+    }
+    return true;
+}
+
+/*
+    Replaces the layers with the ones in a blob from the database, see
+    blobToLayers
+ */
+void VSoil::blobToData(const QByteArray &data)
+{
+    m_record->layers.clear();
+    if(!blobToLayers(data, m_record->layers))
+        qDebug() << "Error in VSoil::blobToData; invalid layer data for vsoil id =" << m_record->id;
+    clearLayerIntegrals();
+}
+
+/*
+    Returns the layers in the binary layout
+    magic (0xBB 'V'), version, flags, varint number of layers,
+    [top zmax if contiguous], per layer [zmax if not contiguous], zmin, zigzag varint soiltype_id
+    The depths are little endian floats if that does not lose precision, else doubles.
+ */
+QByteArray VSoil::layersToBlob(const VSoilLayerList &layers)
+{
+    int n = layers.count();
+    bool asFloat = true;
+    bool contiguous = true;
+    int idSize = 0;
+    for(int i=0; i<n; i++){
+        const VSoilLayer &sl = layers.at(i);
+        if(double(float(sl.zmax)) != sl.zmax || double(float(sl.zmin)) != sl.zmin)
+            asFloat = false;
+        if(i > 0 && layers.at(i-1).zmin != sl.zmax)
+            contiguous = false;
+        idSize += varintSize(zigzag(sl.soiltype_id));
+    }
+    int depthSize = asFloat ? 4 : 8;
+    int numDepths = contiguous ? (n > 0 ? n + 1 : 0) : 2 * n;
+
+    QByteArray result(VSOILBLOB_HEADERSIZE + varintSize(quint64(n)) + numDepths * depthSize + idSize, Qt::Uninitialized);
+    char *p = result.data();
+    *p++ = VSOILBLOB_MAGIC0;
+    *p++ = VSOILBLOB_MAGIC1;
+    *p++ = char(VSOILBLOB_VERSION);
+    *p++ = char((asFloat ? VSOILBLOB_FLOATDEPTHS : 0) | (contiguous ? VSOILBLOB_CONTIGUOUS : 0));
+    p = putVarint(p, quint64(n));
+    if(contiguous && n > 0)
+        p = putDepth(p, layers.at(0).zmax, asFloat);
+    for(int i=0; i<n; i++){
+        const VSoilLayer &sl = layers.at(i);
+        if(!contiguous)
+            p = putDepth(p, sl.zmax, asFloat);
+        p = putDepth(p, sl.zmin, asFloat);
+        p = putVarint(p, zigzag(sl.soiltype_id));
     }
     return result;
 }
 
+QByteArray VSoil::dataAsQByteArray(){
+    return layersToBlob(m_record->layers);
+}
+
 double VSoil::zMin(){
-    if(m_soilLayers->count()>0){
-        return m_soilLayers->at(m_soilLayers->count()-1).zmin;
+    if(m_record->layers.count()>0){
+        return m_record->layers.at(m_record->layers.count()-1).zmin;
     }
     return 9999.;
     //TODO: raise exception
 }
 
 double VSoil::zMax(){
-    if(m_soilLayers->count()>0){
-        return m_soilLayers->at(0).zmax;
+    if(m_record->layers.count()>0){
+        return m_record->layers.at(0).zmax;
     }
     return -9999.;
     //TODO: raise exception
@@ -88,36 +246,34 @@ double VSoil::zMax(){
     other are rebuild into one layer.
  */
 void VSoil::optimize(){
-    QList<VSoilLayer> newList;
+    VSoilLayerList newList;
     double z1 = 0.;
     int id = -1;
 
-    for(int i=0; i<m_soilLayers->count();i++){
+    for(int i=0; i<m_record->layers.count();i++){
         if(i==0){ //first soillayer so set the first limit to the top of this layer
-            z1 = m_soilLayers->at(i).zmax;
-            id = m_soilLayers->at(i).soiltype_id;
+            z1 = m_record->layers.at(i).zmax;
+            id = m_record->layers.at(i).soiltype_id;
         }
-        else if(i==m_soilLayers->count()-1){ //last layer, add this layer
+        else if(i==m_record->layers.count()-1){ //last layer, add this layer
             VSoilLayer vs;
             vs.zmax = z1;
-            vs.zmin = m_soilLayers->at(i).zmin;
+            vs.zmin = m_record->layers.at(i).zmin;
             vs.soiltype_id = id;
             newList.append(vs);
-        }else if(id!=m_soilLayers->at(i).soiltype_id){ //new id, so the layer needs to be added
+        }else if(id!=m_record->layers.at(i).soiltype_id){ //new id, so the layer needs to be added
             VSoilLayer vs;
             vs.zmax = z1;
-            vs.zmin = m_soilLayers->at(i).zmax;
+            vs.zmin = m_record->layers.at(i).zmax;
             vs.soiltype_id = id;
             newList.append(vs);
-            z1 = m_soilLayers->at(i).zmax; //we have a new start limit
-            id = m_soilLayers->at(i).soiltype_id; //and a new id to look for
+            z1 = m_record->layers.at(i).zmax; //we have a new start limit
+            id = m_record->layers.at(i).soiltype_id; //and a new id to look for
         }
     }
     //done, now copy the list to the original list
-    m_soilLayers->clear();
-    for(int i=0; i<newList.count(); i++){
-        m_soilLayers->append(newList[i]);
-    }
+    m_record->layers = newList;
+    clearLayerIntegrals();
 }
 
 void VSoil::addSoilLayer(double zmax, double zmin, int id)
@@ -126,5 +282,82 @@ void VSoil::addSoilLayer(double zmax, double zmin, int id)
     sl.soiltype_id = id;
     sl.zmax = zmax;
     sl.zmin = zmin;
-    m_soilLayers->append(sl);
+    m_record->layers.append(sl);
+    clearLayerIntegrals();
+}
+
+/*
+    Replaces all layers
+ */
+void VSoil::setSoilLayers(const VSoilLayerList &layers)
+{
+    m_record->layers = layers;
+    clearLayerIntegrals();
+}
+
+/*
+    Returns true if the running sums for this parameter are available and
+    were built from soiltypes with the given revision. The sums are removed
+    by the functions that change the layers, code that changes them through
+    getSoilLayers() has to call clearLayerIntegrals itself.
+ */
+bool VSoil::hasLayerIntegral(int parameter, int revision)
+{
+    QHash<int, sLayerIntegral>::const_iterator it = m_layerIntegrals.constFind(parameter);
+    return (it != m_layerIntegrals.constEnd()) && (it.value().revision == revision);
+}
+
+/*
+    Builds the running sums for a parameter, layerValues holds the value of
+    the parameter for every soil layer (in the same order)
+ */
+void VSoil::setLayerIntegral(int parameter, int revision, const QVector<double> &layerValues)
+{
+    sLayerIntegral li;
+    li.revision = revision;
+    li.values = layerValues;
+    li.sums.resize(m_record->layers.count() + 1);
+    li.sums[0] = 0.;
+    for(int i=0; i<m_record->layers.count(); i++){
+        const VSoilLayer &sl = m_record->layers.at(i);
+        li.sums[i+1] = li.sums[i] + (sl.zmax - sl.zmin) * layerValues.at(i);
+    }
+    m_layerIntegrals.insert(parameter, li);
+}
+
+/*
+    Returns the integral of the parameter between zTop and zBottom (zTop > zBottom),
+    parts outside of the layers count as 0. Needs setLayerIntegral first.
+ */
+double VSoil::integrateLayers(int parameter, double zTop, double zBottom)
+{
+    QHash<int, sLayerIntegral>::const_iterator it = m_layerIntegrals.constFind(parameter);
+    if(it == m_layerIntegrals.constEnd())
+        return 0.;
+    const sLayerIntegral &li = it.value();
+    int n = m_record->layers.count();
+
+    //integral from the top of the vsoil down to z
+    double result = 0.;
+    double z = zTop;
+    for(int pass=0; pass<2; pass++){
+        //first layer with zmin < z, the layers are sorted from top to bottom
+        int lo = 0, hi = n;
+        while(lo < hi){
+            int mid = (lo + hi) / 2;
+            if(m_record->layers.at(mid).zmin < z)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        double integral = li.sums[lo];
+        if(lo < n){
+            const VSoilLayer &sl = m_record->layers.at(lo);
+            if(z < sl.zmax)
+                integral += (sl.zmax - z) * li.values.at(lo);
+        }
+        result = (pass == 0) ? -integral : result + integral;
+        z = zBottom;
+    }
+    return result;
 }
@@ -4,6 +4,10 @@
 #include <QObject>
 #include <QString>
 #include <QStringList>
+#include <QVector>
+#include <QHash>
+
+#include "smallvector.h"
 
 struct VSoilLayer{
     double zmin;
@@ -11,57 +15,100 @@ struct VSoilLayer{
     int soiltype_id;
 };
 
+//most vsoils have a handful of layers, those are kept inside the record
+typedef SmallVector<VSoilLayer, 8> VSoilLayerList;
+
+/*
+    The data of one vsoil as a plain value, see EntityStore for the
+    contiguous storage of these records and VSoil for the QObject around it
+ */
+struct sVSoilRecord{
+    sVSoilRecord() : id(-1), x(0.), y(0.), lat(0.), lng(0.), leveeLocation(0), dataChanged(false), enabled(true) {}
+
+    int id;
+    double x;
+    double y;
+    double lat;
+    double lng;
+    int leveeLocation;  //0 = undefined, 1 = crest, 2 = polder
+    bool dataChanged;
+    bool enabled;
+    QString source;
+    QString name;
+    VSoilLayerList layers; //from top to bottom
+};
+
+/*
+    Thickness weighted running sums of one soiltype parameter over the layers,
+    sums[i] is the integral from the top of the vsoil to the top of layer i
+ */
+struct sLayerIntegral{
+    int revision; //revision of the soiltypes the values were taken from
+    QVector<double> values; //value of the parameter per layer
+    QVector<double> sums;
+};
+
+/*
+    QObject facade of a sVSoilRecord for the GUI and the table models. A
+    VSoil either holds its own record or works on a record that lives in an
+    EntityStore, that record has to outlive the VSoil.
+ */
 class VSoil : public QObject
 {
     Q_OBJECT
 public:
     explicit VSoil(QObject *parent = 0);
+    explicit VSoil(sVSoilRecord *record, QObject *parent = 0);
     ~VSoil();
-    void blobToData(QString data);
+    void blobToData(const QByteArray &data);
     QByteArray dataAsQByteArray();
+    static bool isBinaryBlob(const QByteArray &data);
+    static bool blobToLayers(const QByteArray &data, VSoilLayerList &layers);
+    static QByteArray layersToBlob(const VSoilLayerList &layers);
+
+    sVSoilRecord *record() { return m_record; }
+    const sVSoilRecord *record() const { return m_record; }
 
     double zMin();
     double zMax();
-    double x() { return m_x; }
-    double y() { return m_y; }
-    double latitude() { return m_lat; }
-    double longitude() { return m_lng; }
-    QString name() { return m_name; }
-    int levee_location() { return m_leveeLocation; }
-    bool isEnabled() { return m_enabled; }
+    double x() { return m_record->x; }
+    double y() { return m_record->y; }
+    double latitude() { return m_record->lat; }
+    double longitude() { return m_record->lng; }
+    QString name() { return m_record->name; }
+    int levee_location() { return m_record->leveeLocation; }
+    bool isEnabled() { return m_record->enabled; }
 
     void optimize();
 
-    int id() { return m_id; }
-    QString source() { return m_source; }
-    QList<VSoilLayer> *getSoilLayers() { return m_soilLayers; }
+    int id() { return m_record->id; }
+    QString source() { return m_record->source; }
+    VSoilLayerList *getSoilLayers() { return &m_record->layers; } //call clearLayerIntegrals after changing them
+    void setSoilLayers(const VSoilLayerList &layers);
 
-    void setName(QString name) { m_name = name; }
-    void setId(int id) { m_id = id; }
-    void setSource(QString source) { m_source = source; }
-    void setX(double x) { m_x = x; }
-    void setY(double y) { m_y = y; }
-    void setLatitude(double lat) { m_lat = lat; }
-    void setLongitude(double lng) { m_lng = lng; }
-    void setLeveeLocation(int location) { m_leveeLocation = location; }
+    void setName(QString name) { m_record->name = name; }
+    void setId(int id) { m_record->id = id; }
+    void setSource(QString source) { m_record->source = source; }
+    void setX(double x) { m_record->x = x; }
+    void setY(double y) { m_record->y = y; }
+    void setLatitude(double lat) { m_record->lat = lat; }
+    void setLongitude(double lng) { m_record->lng = lng; }
+    void setLeveeLocation(int location) { m_record->leveeLocation = location; }
 
     void addSoilLayer(double zmax, double zmin, int id);
-    bool dataChanged() { return m_dataChanged; }
-    void setDataChanged(bool dataHasChanged) { m_dataChanged = dataHasChanged; }
-    void setEnabled(bool value) { m_enabled = value; }    
+
+    bool hasLayerIntegral(int parameter, int revision);
+    void setLayerIntegral(int parameter, int revision, const QVector<double> &layerValues);
+    double integrateLayers(int parameter, double zTop, double zBottom);
+    void clearLayerIntegrals() { m_layerIntegrals.clear(); }
+    bool dataChanged() { return m_record->dataChanged; }
+    void setDataChanged(bool dataHasChanged) { m_record->dataChanged = dataHasChanged; }
+    void setEnabled(bool value) { m_record->enabled = value; }
 
 private:
-    int m_id;
-    double m_x;
-    double m_y;
-    double m_lat;
-    double m_lng;
-    QString m_source;
-    QList<VSoilLayer> *m_soilLayers;
-    QString m_name;
-    int m_leveeLocation;  //0 = undefined, 1 = crest, 2 = polder
-    bool m_dataChanged;
-    bool m_enabled;
+    sVSoilRecord *m_ownRecord; //NULL if the record lives in an EntityStore
+    sVSoilRecord *m_record;    //m_ownRecord or the record in the store
+    QHash<int, sLayerIntegral> m_layerIntegrals; //by parameter, cleared when the layers change
 
     
 signals:
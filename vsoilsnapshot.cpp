@@ -0,0 +1,259 @@
+#include "vsoilsnapshot.h"
+
+#include <QDebug>
+
+#include <cmath>
+#include <limits>
+
+VSoilSnapshot::VSoilSnapshot(const QList<VSoil*> &vsoils)
+{
+    QVector<sIndexPoint> points;
+    m_items.reserve(vsoils.count());
+    points.reserve(vsoils.count());
+    for(int i=0; i<vsoils.count(); i++){
+        VSoil *vs = vsoils[i];
+        if(!vs->isEnabled())
+            continue;
+        sVSoilSnapshotItem item;
+        item.id = vs->id();
+        item.x = vs->x();
+        item.y = vs->y();
+        item.zmin = vs->zMin();
+        item.zmax = vs->zMax();
+        for(int j=0; j<vs->getSoilLayers()->count(); j++){
+            int id = vs->getSoilLayers()->at(j).soiltype_id;
+            if(!item.soilTypeIds.contains(id))
+                item.soilTypeIds.append(id);
+        }
+        sIndexPoint p;
+        p.x = item.x;
+        p.y = item.y;
+        p.index = m_items.count();
+        points.append(p);
+        m_items.append(item);
+    }
+    m_index.build(points);
+}
+
+/*
+  Adds the area [start, end] for the item at itemIndex (or -1 if there is
+  none) to the profile and extends the limits and soiltypes of the profile
+  with this item. Consecutive areas of the same vsoil are merged.
+  */
+void VSoilSnapshot::addArea(GeoProfile2D *geo, double start, double end, int itemIndex) const
+{
+    int id = -1;
+    if(itemIndex > -1){
+        const sVSoilSnapshotItem &item = m_items.at(itemIndex);
+        id = item.id;
+        if(geo->zMax() < item.zmax)
+            geo->setZMax(item.zmax);
+        if(geo->zMin() > item.zmin)
+            geo->setZMin(item.zmin);
+        geo->addSoilTypeIDs(item.soilTypeIds);
+    }
+    if(geo->areas()->count() > 0 && geo->areas()->last().vsoilId == id){
+        geo->areas()->last().end = end;
+    }else{
+        sArea a;
+        a.start = start;
+        a.end = end;
+        a.vsoilId = id;
+        geo->areas()->append(a);
+    }
+}
+
+/*
+  Generates a profile by looking up the closest vsoil every meter along the
+  lines, the areas start and end on whole meters.
+  */
+GeoProfile2D *VSoilSnapshot::sampledProfile(const ProjectedPolyline &polyline) const
+{
+    GeoProfile2D *geo = new GeoProfile2D();
+    geo->setZMax(-9999.); //used to store the min z value in profile
+    geo->setZMin(9999.); //used to store the max z value in profile
+    //initialization
+    int id = -1;
+    double currentLength = 0.;
+    double prevLength = 0.;
+
+    //add the lines to the geoprofile so we always know from which line it was generated
+    for(int i=0; i<polyline.count(); i++)
+        geo->points()->append(polyline.latlon(i));
+
+    //wander through all lines
+    for(int i=0; i<polyline.count()-1; i++){
+        //get the start- and endpoint in rdcoords
+        QPointF p1rd = polyline.rd(i);
+        QPointF p2rd = polyline.rd(i+1);
+        //how long is this line..
+        int dL = int(sqrt((p2rd.x() - p1rd.x()) * (p2rd.x() - p1rd.x()) + ((p2rd.y() - p1rd.y()) * (p2rd.y() - p1rd.y()))));
+        //richtingsvector.. in english?
+        QPointF rv((p2rd.x() - p1rd.x()), (p2rd.y() - p1rd.y()));
+        //walk across the line in 1m steps
+
+        for(int j=0; j<=dL; j++){
+            //step one meter along the line
+            int x = int(p1rd.x() + j * rv.x() / dL);
+            int y = int(p1rd.y() + j * rv.y() / dL);
+            //find the closest vsoil based on the current coord
+            int idx = nearest(QPointF(x,y));
+            int cId = (idx > -1) ? m_items.at(idx).id : -1;
+            //TODO: what if cId == -1?
+            if(idx > -1){ //check the limits
+                const sVSoilSnapshotItem &item = m_items.at(idx);
+                if(geo->zMax() < item.zmax)
+                    geo->setZMax(item.zmax);
+                if(geo->zMin() > item.zmin)
+                    geo->setZMin(item.zmin);
+                geo->addSoilTypeIDs(item.soilTypeIds);
+            }
+            if(j==0){ //first point, just set the id to the current id
+                id = cId; //set the id to the newly found id
+                prevLength = 0.; //set the previous length to zero
+            }
+            else if((j==dL)||(id!=cId)){ //last point or new id, add the line
+                sArea l; //create new line
+                l.start = currentLength + prevLength; //it started where the latter ended
+                l.end = currentLength + j; //and now it is a the current length
+                l.vsoilId = id; //with this new id
+                geo->areas()->append(l); //add it to the result
+                id = cId; //set the id to the new id
+                prevLength = j; //and make sure the prev length equals the current length
+                if(j==dL) { currentLength += j; } //keep the current length for the next line
+            }
+        }
+
+    }
+    geo->optimize();
+    return geo;
+}
+
+/*
+  Fills [t, length] of the line p1rd + u * (ux, uy) with the closest vsoil
+  every meter, used when the voronoi walk can not finish a segment
+  */
+void VSoilSnapshot::addSampledAreas(GeoProfile2D *geo, QPointF p1rd, double ux, double uy, double t, double length, double offset) const
+{
+    while(t < length){
+        double e = qMin(length, t + 1.);
+        double m = (t + e) / 2.;
+        addArea(geo, offset + t, offset + e, nearest(QPointF(p1rd.x() + m * ux, p1rd.y() + m * uy), std::numeric_limits<double>::max()));
+        t = e;
+    }
+}
+
+/*
+  Generates a profile from the exact crossings of the lines with the voronoi
+  cells of the vsoils, see addVoronoiAreas
+  */
+GeoProfile2D *VSoilSnapshot::voronoiProfile(const ProjectedPolyline &polyline) const
+{
+    GeoProfile2D *geo = new GeoProfile2D();
+    geo->setZMax(-9999.); //used to store the min z value in profile
+    geo->setZMin(9999.); //used to store the max z value in profile
+
+    for(int i=0; i<polyline.count(); i++)
+        geo->points()->append(polyline.latlon(i));
+
+    double offset = 0.;
+    for(int i=0; i<polyline.count()-1; i++){
+        QPointF p1rd = polyline.rd(i);
+        QPointF p2rd = polyline.rd(i+1);
+        addVoronoiAreas(geo, p1rd, p2rd, offset);
+        offset += sqrt((p2rd.x() - p1rd.x()) * (p2rd.x() - p1rd.x()) + (p2rd.y() - p1rd.y()) * (p2rd.y() - p1rd.y()));
+    }
+    return geo;
+}
+
+/*
+  Walks the line p1rd -> p2rd through the voronoi cells of the enabled vsoils.
+  Within a convex cell it is enough to know the owner of the end of the part
+  that is left; if that is another vsoil the cell is left at the bisector of
+  both vsoils or earlier, so we move the end to that bisector and try again.
+  This gives the exact crossings with one nearest neighbour search per step
+  instead of one per meter.
+  */
+void VSoilSnapshot::addVoronoiAreas(GeoProfile2D *geo, QPointF p1rd, QPointF p2rd, double offset) const
+{
+    const double maxDistance = std::numeric_limits<double>::max();
+    const double eps = 1e-6; //[m] used to step into the next cell
+
+    double dx = p2rd.x() - p1rd.x();
+    double dy = p2rd.y() - p1rd.y();
+    double length = sqrt(dx * dx + dy * dy);
+    if(length <= 0.)
+        return;
+    //unit direction vector
+    double ux = dx / length;
+    double uy = dy / length;
+
+    int current = nearest(p1rd, maxDistance);
+    if(current == -1){ //no vsoils at all
+        addArea(geo, offset, offset + length, -1);
+        return;
+    }
+
+    //a straight segment enters every convex cell at most once and every
+    //cell can cost one extra step for rounding, more steps mean the walk
+    //is stuck
+    const int maxSteps = 2 * m_items.count() + 16;
+    double t = 0.;
+    int steps = 0;
+    while(t < length){
+        if(steps++ >= maxSteps){
+            qDebug() << QString("VSoilSnapshot: voronoi walk stopped after %1 steps at %2 of %3 m, sampling the rest of the segment").arg(maxSteps).arg(offset + t, 0, 'f', 2).arg(offset + length, 0, 'f', 2);
+            addSampledAreas(geo, p1rd, ux, uy, t, length, offset);
+            return;
+        }
+        double e = length;
+        int other = -1;
+        double sx = m_items.at(current).x;
+        double sy = m_items.at(current).y;
+        //shrink [t, e] until the owner of e is the current vsoil
+        for(int i=0; i<1000; i++){
+            QPointF pe(p1rd.x() + e * ux, p1rd.y() + e * uy);
+            int r = nearest(pe, maxDistance);
+            if(r == current)
+                break;
+            double rx = m_items.at(r).x;
+            double ry = m_items.at(r).y;
+            double ds = (pe.x() - sx) * (pe.x() - sx) + (pe.y() - sy) * (pe.y() - sy);
+            double dr = (pe.x() - rx) * (pe.x() - rx) + (pe.y() - ry) * (pe.y() - ry);
+            if(dr >= ds) //on the bisector, this is the end of the cell
+                break;
+            other = r;
+            //solve |P(u) - S|^2 = |P(u) - R|^2 with P(u) = p1 + u * dir
+            double ax = p1rd.x(), ay = p1rd.y();
+            double denom = 2. * (ux * (rx - sx) + uy * (ry - sy));
+            if(denom <= 0.)
+                break;
+            double u = (((ax - rx) * (ax - rx) + (ay - ry) * (ay - ry)) -
+                        ((ax - sx) * (ax - sx) + (ay - sy) * (ay - sy))) / denom;
+            if(u <= t){
+                e = t;
+                break;
+            }
+            if(u >= e)
+                break;
+            e = u;
+        }
+
+        if(e > t)
+            addArea(geo, offset + t, offset + e, current);
+        if(e >= length)
+            break;
+
+        //find the owner of the next cell
+        double tn = qMin(length, e + eps);
+        int next = nearest(QPointF(p1rd.x() + tn * ux, p1rd.y() + tn * uy), maxDistance);
+        if(next == current)
+            next = (other > -1) ? other : next;
+        if(next == current){ //nothing changes (rounding), just continue after this point
+            t = tn;
+            continue;
+        }
+        t = e;
+        current = next;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef VSOILSNAPSHOT_H
+#define VSOILSNAPSHOT_H
+
+#include <QList>
+#include <QVector>
+#include <QPointF>
+
+#include "vsoil.h"
+#include "geoprofile2d.h"
+#include "spatialindex.h"
+#include "latlon.h"
+
+struct sVSoilSnapshotItem{
+    int id;
+    double x;
+    double y;
+    double zmin;
+    double zmax;
+    QList<int> soilTypeIds; //unique soiltype ids of the layers
+};
+
+/*
+    A read-only copy of the enabled vsoils with a kd-tree on their rd
+    coordinates. It does not refer to the VSoil objects after it is built
+    so it can be shared between threads and keeps working while the
+    datastore changes its vsoils. The depth limits and soiltypes of the
+    profiles are taken from the layers at the time the snapshot is built,
+    DataStore refreshes them from the live vsoils when it stores a profile.
+ */
+class VSoilSnapshot
+{
+public:
+    explicit VSoilSnapshot(const QList<VSoil*> &vsoils);
+
+    int count() const { return m_items.count(); }
+    const sVSoilSnapshotItem &at(int index) const { return m_items.at(index); }
+
+    int nearest(QPointF xy, double maxDistanceSquared = 1e9) const { return m_index.nearest(xy, maxDistanceSquared); }
+    void kNearest(QPointF xy, int k, QList<int> &indexes) const { m_index.kNearest(xy, k, indexes); }
+    void withinRadius(QPointF xy, double radius, QList<int> &indexes) const { m_index.withinRadius(xy, radius, indexes); }
+
+    GeoProfile2D *sampledProfile(const ProjectedPolyline &polyline) const;
+    GeoProfile2D *voronoiProfile(const ProjectedPolyline &polyline) const;
+
+private:
+    QVector<sVSoilSnapshotItem> m_items;
+    SpatialIndex m_index; //kd-tree on m_items
+
+    void addArea(GeoProfile2D *geo, double start, double end, int itemIndex) const;
+    void addVoronoiAreas(GeoProfile2D *geo, QPointF p1rd, QPointF p2rd, double offset) const;
+    void addSampledAreas(GeoProfile2D *geo, QPointF p1rd, double ux, double uy, double t, double length, double offset) const;
+};
+
+#endif // VSOILSNAPSHOT_H